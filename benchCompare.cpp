@@ -0,0 +1,472 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <cctype>
+#include <cstdlib>
+
+struct JsonValue {
+    enum class Type { Null, Number, String, Array, Object };
+
+    Type type{Type::Null};
+    double number{0.0};
+    std::string text;
+    std::vector<JsonValue> items;
+    std::map<std::string, JsonValue> fields;
+
+    const JsonValue* find(const std::string& key) const {
+        auto it = fields.find(key);
+        return it == fields.end() ? nullptr : &it->second;
+    }
+};
+
+class JsonParser {
+private:
+    const std::string& input;
+    size_t pos{0};
+
+    void skipSpace() {
+        while (pos < input.size() && std::isspace(static_cast<unsigned char>(input[pos]))) {
+            pos++;
+        }
+    }
+
+    bool expect(char c) {
+        skipSpace();
+        if (pos < input.size() && input[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    bool parseString(std::string& out) {
+        if (!expect('"')) {
+            return false;
+        }
+        while (pos < input.size() && input[pos] != '"') {
+            if (input[pos] == '\\' && pos + 1 < input.size()) {
+                pos++;
+            }
+            out += input[pos++];
+        }
+        return expect('"');
+    }
+
+public:
+    explicit JsonParser(const std::string& text) : input(text) {}
+
+    bool parse(JsonValue& value) {
+        skipSpace();
+        if (pos >= input.size()) {
+            return false;
+        }
+
+        char c = input[pos];
+        if (c == '{') {
+            pos++;
+            value.type = JsonValue::Type::Object;
+            if (expect('}')) {
+                return true;
+            }
+            do {
+                std::string key;
+                if (!parseString(key) || !expect(':') || !parse(value.fields[key])) {
+                    return false;
+                }
+            } while (expect(','));
+            return expect('}');
+        }
+        if (c == '[') {
+            pos++;
+            value.type = JsonValue::Type::Array;
+            if (expect(']')) {
+                return true;
+            }
+            do {
+                value.items.emplace_back();
+                if (!parse(value.items.back())) {
+                    return false;
+                }
+            } while (expect(','));
+            return expect(']');
+        }
+        if (c == '"') {
+            value.type = JsonValue::Type::String;
+            return parseString(value.text);
+        }
+        if (input.compare(pos, 4, "null") == 0) {
+            pos += 4;
+            value.type = JsonValue::Type::Null;
+            return true;
+        }
+
+        size_t consumed = 0;
+        try {
+            value.number = std::stod(input.substr(pos), &consumed);
+        } catch (...) {
+            return false;
+        }
+        pos += consumed;
+        value.type = JsonValue::Type::Number;
+        return true;
+    }
+};
+
+struct Scenario {
+    std::string name;
+    std::string args;
+    std::vector<double> parties_per_sec;
+};
+
+std::string escapeJson(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+bool loadScenarioFile(const std::string& path, std::vector<Scenario>& scenarios) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') {
+            continue;
+        }
+
+        Scenario scenario;
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            scenario.name = line.substr(start);
+        } else {
+            scenario.name = line.substr(start, colon - start);
+            size_t args_start = line.find_first_not_of(" \t", colon + 1);
+            scenario.args = args_start == std::string::npos ? "" : line.substr(args_start);
+        }
+        while (!scenario.name.empty() && std::isspace(static_cast<unsigned char>(scenario.name.back()))) {
+            scenario.name.pop_back();
+        }
+        scenarios.push_back(scenario);
+    }
+    return true;
+}
+
+bool loadResults(const std::string& path, std::vector<Scenario>& scenarios) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+
+    JsonValue root;
+    JsonParser parser(text);
+    if (!parser.parse(root) || root.type != JsonValue::Type::Object) {
+        return false;
+    }
+
+    const JsonValue* list = root.find("scenarios");
+    if (list == nullptr || list->type != JsonValue::Type::Array) {
+        return false;
+    }
+
+    for (const auto& item : list->items) {
+        const JsonValue* name = item.find("name");
+        const JsonValue* samples = item.find("parties_per_sec");
+        if (name == nullptr || samples == nullptr) {
+            return false;
+        }
+
+        Scenario scenario;
+        scenario.name = name->text;
+        if (const JsonValue* args = item.find("args")) {
+            scenario.args = args->text;
+        }
+        for (const auto& sample : samples->items) {
+            scenario.parties_per_sec.push_back(sample.number);
+        }
+        scenarios.push_back(scenario);
+    }
+    return true;
+}
+
+bool saveResults(const std::string& path, const std::string& binary, int runs,
+                 const std::vector<Scenario>& scenarios) {
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path);
+        if (!out) {
+            return false;
+        }
+
+        out << "{\"binary\":\"" << escapeJson(binary) << "\",\"runs\":" << runs << ",\"scenarios\":[";
+        for (size_t i = 0; i < scenarios.size(); i++) {
+            out << (i > 0 ? "," : "") << "\n  {\"name\":\"" << escapeJson(scenarios[i].name)
+                << "\",\"args\":\"" << escapeJson(scenarios[i].args) << "\",\"parties_per_sec\":[";
+            for (size_t j = 0; j < scenarios[i].parties_per_sec.size(); j++) {
+                out << (j > 0 ? "," : "") << std::fixed << std::setprecision(3)
+                    << scenarios[i].parties_per_sec[j];
+            }
+            out << "]}";
+        }
+        out << "\n]}" << std::endl;
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+bool runScenario(const std::string& binary, Scenario& scenario, int runs) {
+    std::string command = binary + " --bench-json " + scenario.args;
+
+    for (int run = 0; run < runs; run++) {
+        std::unique_ptr<FILE, int (*)(FILE*)> pipe(popen(command.c_str(), "r"), pclose);
+        if (!pipe) {
+            return false;
+        }
+
+        std::string output;
+        char buffer[512];
+        while (fgets(buffer, sizeof(buffer), pipe.get()) != nullptr) {
+            output += buffer;
+        }
+
+        JsonValue result;
+        JsonParser parser(output);
+        const JsonValue* throughput = nullptr;
+        if (!parser.parse(result) || (throughput = result.find("parties_per_sec")) == nullptr) {
+            std::cerr << "Scenario " << scenario.name << ": could not parse output of '"
+                      << command << "'" << std::endl;
+            return false;
+        }
+        scenario.parties_per_sec.push_back(throughput->number);
+        std::cerr << "  " << scenario.name << " run " << (run + 1) << "/" << runs << ": "
+                  << std::fixed << std::setprecision(0) << throughput->number << " parties/s" << std::endl;
+    }
+    return true;
+}
+
+double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return values.size() % 2 == 1 ? values[mid] : (values[mid - 1] + values[mid]) / 2.0;
+}
+
+double mannWhitneyPValue(const std::vector<double>& a, const std::vector<double>& b) {
+    std::vector<std::pair<double, int>> combined;
+    for (double value : a) {
+        combined.push_back({value, 0});
+    }
+    for (double value : b) {
+        combined.push_back({value, 1});
+    }
+    std::sort(combined.begin(), combined.end());
+
+    double n1 = a.size();
+    double n2 = b.size();
+    double total = n1 + n2;
+    double rank_sum_a = 0.0;
+    double tie_term = 0.0;
+
+    for (size_t i = 0; i < combined.size();) {
+        size_t j = i;
+        while (j < combined.size() && combined[j].first == combined[i].first) {
+            j++;
+        }
+        double average_rank = (i + 1 + j) / 2.0;
+        double ties = static_cast<double>(j - i);
+        tie_term += ties * ties * ties - ties;
+        for (size_t k = i; k < j; k++) {
+            if (combined[k].second == 0) {
+                rank_sum_a += average_rank;
+            }
+        }
+        i = j;
+    }
+
+    double u = rank_sum_a - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((total + 1) - tie_term / (total * (total - 1)));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+
+    double z = (std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+    return std::erfc(std::max(z, 0.0) / std::sqrt(2.0));
+}
+
+std::pair<double, double> bootstrapChangeInterval(const std::vector<double>& baseline,
+                                                  const std::vector<double>& current) {
+    std::mt19937 gen(12345);
+    std::uniform_int_distribution<size_t> pick_baseline(0, baseline.size() - 1);
+    std::uniform_int_distribution<size_t> pick_current(0, current.size() - 1);
+    std::vector<double> changes;
+    std::vector<double> resample_baseline(baseline.size());
+    std::vector<double> resample_current(current.size());
+
+    for (int i = 0; i < 2000; i++) {
+        for (auto& value : resample_baseline) {
+            value = baseline[pick_baseline(gen)];
+        }
+        for (auto& value : resample_current) {
+            value = current[pick_current(gen)];
+        }
+        changes.push_back((median(resample_current) / median(resample_baseline) - 1.0) * 100.0);
+    }
+
+    std::sort(changes.begin(), changes.end());
+    return {changes[changes.size() * 25 / 1000], changes[changes.size() * 975 / 1000]};
+}
+
+int compareResults(const std::vector<Scenario>& baseline, const std::vector<Scenario>& current,
+                   double threshold_percent, double alpha) {
+    int regressions = 0;
+
+    std::cout << std::left << std::setw(20) << "Scenario" << std::right
+              << std::setw(14) << "Baseline" << std::setw(14) << "Current"
+              << std::setw(10) << "Change" << std::setw(22) << "95% CI"
+              << std::setw(10) << "p-value" << "  Verdict" << std::endl;
+    std::cout << std::string(100, '-') << std::endl;
+
+    for (const auto& scenario : current) {
+        auto it = std::find_if(baseline.begin(), baseline.end(),
+                               [&](const Scenario& s) { return s.name == scenario.name; });
+        if (it == baseline.end() || it->parties_per_sec.empty() || scenario.parties_per_sec.empty()) {
+            std::cout << std::left << std::setw(20) << scenario.name << std::right
+                      << "  no baseline" << std::endl;
+            continue;
+        }
+
+        double base_median = median(it->parties_per_sec);
+        double current_median = median(scenario.parties_per_sec);
+        double change = (current_median / base_median - 1.0) * 100.0;
+        double p_value = mannWhitneyPValue(it->parties_per_sec, scenario.parties_per_sec);
+        auto interval = bootstrapChangeInterval(it->parties_per_sec, scenario.parties_per_sec);
+
+        std::string verdict = "same";
+        if (p_value < alpha && change < -threshold_percent) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (p_value < alpha && change > threshold_percent) {
+            verdict = "faster";
+        }
+
+        std::ostringstream ci;
+        ci << std::fixed << std::setprecision(1) << "[" << interval.first << "%, " << interval.second << "%]";
+        std::cout << std::left << std::setw(20) << scenario.name << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(14) << base_median << std::setw(14) << current_median
+                  << std::setprecision(1) << std::setw(9) << change << "%" << std::setw(22) << ci.str()
+                  << std::setprecision(4) << std::setw(10) << p_value << "  " << verdict << std::endl;
+    }
+
+    std::cout << std::string(100, '-') << std::endl;
+    std::cout << regressions << " regression(s) beyond " << std::setprecision(1) << threshold_percent
+              << "% at alpha " << std::setprecision(3) << alpha << std::endl;
+    return regressions > 0 ? 1 : 0;
+}
+
+void printUsage(const char* program) {
+    std::cerr << "Usage:\n"
+              << "  " << program << " record <scenarios.txt> <runs> <out.json> [--binary=PATH]\n"
+              << "  " << program << " compare <baseline.json> <current.json> [--threshold=PCT] [--alpha=A]\n"
+              << "  " << program << " check <scenarios.txt> <runs> <baseline.json> [--binary=PATH]"
+              << " [--threshold=PCT] [--alpha=A] [--save=current.json]\n"
+              << "Scenario file lines look like 'name: --bench-parties=100000 --bench-producers=2'.\n"
+              << "Exit code is 1 when a regression is found and 2 on usage or I/O errors." << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    std::string command = argv[1];
+    std::vector<std::string> positional;
+    std::string binary = "./dungeonManagerProducer";
+    std::string save_path;
+    double threshold_percent = 5.0;
+    double alpha = 0.05;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--binary=", 0) == 0) {
+            binary = arg.substr(9);
+        } else if (arg.rfind("--threshold=", 0) == 0) {
+            threshold_percent = std::atof(arg.c_str() + 12);
+        } else if (arg.rfind("--alpha=", 0) == 0) {
+            alpha = std::atof(arg.c_str() + 8);
+        } else if (arg.rfind("--save=", 0) == 0) {
+            save_path = arg.substr(7);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (command == "compare" && positional.size() == 2) {
+        std::vector<Scenario> baseline, current;
+        if (!loadResults(positional[0], baseline) || !loadResults(positional[1], current)) {
+            std::cerr << "Could not read benchmark results." << std::endl;
+            return 2;
+        }
+        return compareResults(baseline, current, threshold_percent, alpha);
+    }
+
+    if ((command == "record" || command == "check") && positional.size() == 3) {
+        std::vector<Scenario> scenarios;
+        int runs = std::atoi(positional[1].c_str());
+        if (runs < 2 || !loadScenarioFile(positional[0], scenarios) || scenarios.empty()) {
+            std::cerr << "Need a non-empty scenario file and at least 2 runs." << std::endl;
+            return 2;
+        }
+
+        for (auto& scenario : scenarios) {
+            if (!runScenario(binary, scenario, runs)) {
+                return 2;
+            }
+        }
+
+        if (command == "record") {
+            if (!saveResults(positional[2], binary, runs, scenarios)) {
+                std::cerr << "Could not write " << positional[2] << std::endl;
+                return 2;
+            }
+            std::cout << "Saved " << scenarios.size() << " scenario(s) to " << positional[2] << std::endl;
+            return 0;
+        }
+
+        std::vector<Scenario> baseline;
+        if (!loadResults(positional[2], baseline)) {
+            std::cerr << "Could not read baseline " << positional[2] << std::endl;
+            return 2;
+        }
+        if (!save_path.empty() && !saveResults(save_path, binary, runs, scenarios)) {
+            std::cerr << "Could not write " << save_path << std::endl;
+            return 2;
+        }
+        return compareResults(baseline, scenarios, threshold_percent, alpha);
+    }
+
+    printUsage(argv[0]);
+    return 2;
+}
@@ -0,0 +1,135 @@
+#include "ingestionGuard.h"
+#include "toolOptions.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+
+// Measures the per-request cost of the ingestion guard and, with
+// --account-stats, the account analytics (ingestionGuard.h) from many
+// client threads.
+
+void runIngestionBenchmark(int threads, long long requests, uint64_t accounts, int per_minute, int burst, int dedup_ms,
+                           bool account_stats) {
+    IngestionGuard guard(per_minute, burst, dedup_ms, accounts);
+    AccountAnalytics analytics;
+    std::vector<std::thread> clients;
+    std::vector<IngestionGuard::Counts> per_thread(threads);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        clients.emplace_back([&, t]() {
+            std::mt19937_64 account_gen(t + 1);
+            AccountAnalytics::Writer* stats = account_stats ? &analytics.writer() : nullptr;
+            int64_t hour = AccountAnalytics::currentHour();
+            long long share = requests / threads;
+            uint32_t now_ms = guard.nowMs();
+            for (long long i = 0; i < share; i++) {
+                if ((i & 1023) == 0) {
+                    now_ms = guard.nowMs();
+                }
+                uint64_t account = 1 + static_cast<uint64_t>((static_cast<unsigned __int128>(account_gen()) * accounts) >> 64);
+                if (stats != nullptr) {
+                    stats->record(account, hour);
+                }
+                guard.admit(account, now_ms);
+            }
+        });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+    double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    IngestionGuard::Counts counts = guard.counts();
+    long long total = counts.admitted + counts.limited + counts.duplicates + counts.table_full;
+    std::cout << "\n=== INGESTION GUARD BENCHMARK ===" << std::endl;
+    std::cout << "Threads: " << threads << " | Accounts: " << accounts << " | Limit: " << per_minute
+              << "/min, burst " << burst << " | Duplicate window: " << dedup_ms << " ms" << std::endl;
+    std::cout << "Requests: " << total << " in " << std::fixed << std::setprecision(2) << elapsed_ns / 1e6
+              << " ms (" << std::setprecision(1) << elapsed_ns / total << " ns per request, "
+              << std::setprecision(0) << total / (elapsed_ns / 1e9) << " requests/s)" << std::endl;
+    std::cout << "Admitted: " << counts.admitted << " | Rate limited: " << counts.limited
+              << " | Duplicates: " << counts.duplicates << " | Table full: " << counts.table_full
+              << " | Evicted: " << counts.evicted << std::endl;
+    if (account_stats) {
+        // Replay the client streams to count distinct accounts exactly.
+        std::vector<bool> seen(accounts + 1, false);
+        uint64_t distinct = 0;
+        for (int t = 0; t < threads; t++) {
+            std::mt19937_64 account_gen(t + 1);
+            for (long long i = 0; i < requests / threads; i++) {
+                uint64_t account = 1 + static_cast<uint64_t>((static_cast<unsigned __int128>(account_gen()) * accounts) >> 64);
+                distinct += !seen[account];
+                seen[account] = true;
+            }
+        }
+        AccountAnalytics::Report report = analytics.report();
+        AccountAnalytics::print(report);
+        std::cout << "Exact unique accounts: " << distinct << " (HyperLogLog error " << std::showpos
+                  << std::setprecision(2) << (report.unique_total / distinct - 1.0) * 100.0 << std::noshowpos << "%)"
+                  << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    long long threads = std::max(1u, std::thread::hardware_concurrency());
+    long long requests = 10000000;
+    long long accounts = 100000;
+    long long rate_limit = 6;
+    long long rate_burst = 3;
+    long long dedup_ms = 2000;
+    bool account_stats = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--threads", value)) {
+            if (!parseCount(value, 1, INT_MAX, threads)) {
+                std::cerr << "Invalid --threads: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--requests", value)) {
+            if (!parseCount(value, 1, LLONG_MAX, requests)) {
+                std::cerr << "Invalid --requests: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--accounts", value)) {
+            if (!parseCount(value, 1, INT_MAX, accounts)) {
+                std::cerr << "Invalid --accounts: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--rate-limit", value)) {
+            if (!parseCount(value, 1, INT_MAX, rate_limit)) {
+                std::cerr << "Invalid --rate-limit: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--rate-burst", value)) {
+            if (!parseCount(value, 1, INT_MAX, rate_burst)) {
+                std::cerr << "Invalid --rate-burst: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--dedup-ms", value)) {
+            if (!parseCount(value, 0, INT_MAX, dedup_ms)) {
+                std::cerr << "Invalid --dedup-ms: " << value << std::endl;
+                return 1;
+            }
+        } else if (arg == "--account-stats") {
+            account_stats = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--threads=N] [--requests=N] [--accounts=N] [--rate-limit=PER_MIN]"
+                      << " [--rate-burst=N] [--dedup-ms=MS] [--account-stats]" << std::endl;
+            return 1;
+        }
+    }
+    runIngestionBenchmark(static_cast<int>(threads), requests, static_cast<uint64_t>(accounts), static_cast<int>(rate_limit),
+                          static_cast<int>(rate_burst), static_cast<int>(dedup_ms), account_stats);
+    return 0;
+}
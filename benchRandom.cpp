@@ -0,0 +1,78 @@
+#include "bulkRandom.h"
+#include "toolOptions.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+
+// Compares BulkRandom (bulkRandom.h) with std::mt19937_64 plus <random>
+// distributions on the draws the simulators make most: dungeon durations
+// and role picks.
+
+void runRandomBenchmark(long long draws) {
+    const double weights[3]{1.0, 1.0, 1.0};
+    long long checksum = 0;
+    auto report = [&](const std::string& name, std::chrono::steady_clock::duration elapsed, double baseline_ns) {
+        double ns = std::chrono::duration<double, std::nano>(elapsed).count() / draws;
+        std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << ns << " ns/draw" << std::setw(10) << (baseline_ns > 0 ? baseline_ns / ns : 1.0)
+                  << "x" << std::endl;
+        return ns;
+    };
+
+    std::cout << "\n=== RANDOM DRAW BENCHMARK ===" << std::endl;
+    std::cout << draws << " dungeon durations (1-5s) and " << draws << " role picks per engine" << std::endl;
+
+    std::mt19937_64 engine(1);
+    std::uniform_int_distribution<> time_dist(1, 5);
+    std::discrete_distribution<> role_dist(weights, weights + 3);
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < draws; i++) {
+        checksum += time_dist(engine) + role_dist(engine);
+    }
+    double baseline = report("mt19937_64 + <random> distributions", std::chrono::steady_clock::now() - start, 0.0);
+
+    BulkRandom bulk(1);
+    start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < draws; i++) {
+        checksum += bulk.between(1, 5) + bulk.weighted(weights);
+    }
+    report("BulkRandom per-draw pulls", std::chrono::steady_clock::now() - start, baseline);
+
+    std::vector<int> durations(4096);
+    start = std::chrono::steady_clock::now();
+    for (long long done = 0; done < draws; done += static_cast<long long>(durations.size())) {
+        size_t count = static_cast<size_t>(std::min<long long>(durations.size(), draws - done));
+        bulk.fillBetween(durations.data(), count, 1, 5);
+        for (size_t i = 0; i < count; i++) {
+            checksum += durations[i] + bulk.weighted(weights);
+        }
+    }
+    report("BulkRandom bulk durations", std::chrono::steady_clock::now() - start, baseline);
+    std::cout << "Checksum: " << checksum << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    long long draws = 100000000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--draws", value)) {
+            if (!parseCount(value, 1, LLONG_MAX, draws)) {
+                std::cerr << "Invalid --draws: " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--draws=N]" << std::endl;
+            return 1;
+        }
+    }
+    runRandomBenchmark(draws);
+    return 0;
+}
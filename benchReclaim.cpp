@@ -0,0 +1,472 @@
+#include "reclaim.h"
+#include "toolOptions.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <climits>
+
+// Benchmarks deferred reclamation (reclaim.h) on a lock-free player queue.
+
+// Reclamation schemes behind one per-thread interface for the lock-free
+// structures below: enter()/exit() around each operation, protect() for
+// every shared pointer that is dereferenced and retire() for every object
+// that has been unlinked.
+struct FreeAtExit {
+    std::atomic<size_t> outstanding{0};
+    std::mutex lock;
+    std::vector<RetiredObject> retired;
+
+    FreeAtExit() = default;
+
+    ~FreeAtExit() {
+        for (const auto& object : retired) {
+            object.destroy(object.object);
+        }
+    }
+
+    size_t pending() const {
+        return outstanding.load(std::memory_order_relaxed);
+    }
+
+    // Keeps every retired object until the domain is destroyed: the cost of
+    // retiring without any reclamation work.
+    class Thread {
+    private:
+        FreeAtExit& domain;
+        std::vector<RetiredObject> retired;
+
+    public:
+        explicit Thread(FreeAtExit& owner) : domain(owner) {}
+
+        ~Thread() {
+            std::lock_guard<std::mutex> guard(domain.lock);
+            domain.retired.insert(domain.retired.end(), retired.begin(), retired.end());
+        }
+
+        void enter() {}
+        void exit() {}
+
+        template <typename T>
+        T* protect(int, const std::atomic<T*>& source) {
+            return source.load(std::memory_order_acquire);
+        }
+
+        template <typename T>
+        void retire(T* object) {
+            retired.push_back({object, destroyRetired<T>, 0});
+            domain.outstanding.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+};
+
+// Deletes retired objects at once. Only safe with a single thread; used as
+// the baseline for the per-call costs.
+struct ImmediateFree {
+    size_t pending() const {
+        return 0;
+    }
+
+    class Thread {
+    public:
+        explicit Thread(ImmediateFree&) {}
+
+        void enter() {}
+        void exit() {}
+
+        template <typename T>
+        T* protect(int, const std::atomic<T*>& source) {
+            return source.load(std::memory_order_acquire);
+        }
+
+        template <typename T>
+        void retire(T* object) {
+            delete object;
+        }
+    };
+};
+
+struct EpochReclaim {
+    EpochDomain domain;
+
+    size_t pending() const {
+        return domain.pending();
+    }
+
+    class Thread {
+    private:
+        EpochDomain::Thread thread;
+
+    public:
+        explicit Thread(EpochReclaim& owner) : thread(owner.domain) {}
+
+        void enter() {
+            thread.enter();
+        }
+
+        void exit() {
+            thread.exit();
+        }
+
+        template <typename T>
+        T* protect(int, const std::atomic<T*>& source) {
+            return source.load(std::memory_order_acquire);
+        }
+
+        template <typename T>
+        void retire(T* object) {
+            thread.retire(object);
+        }
+    };
+};
+
+struct HazardReclaim {
+    HazardDomain domain;
+
+    size_t pending() const {
+        return domain.pending();
+    }
+
+    class Thread {
+    private:
+        HazardDomain::Thread thread;
+
+    public:
+        explicit Thread(HazardReclaim& owner) : thread(owner.domain) {}
+
+        void enter() {}
+
+        void exit() {
+            thread.clearAll();
+        }
+
+        template <typename T>
+        T* protect(int slot, const std::atomic<T*>& source) {
+            return thread.protect(slot, source);
+        }
+
+        template <typename T>
+        void retire(T* object) {
+            thread.retire(object);
+        }
+    };
+};
+
+struct PlayerNode {
+    uint64_t player;
+    int role;
+    std::atomic<PlayerNode*> next{nullptr};
+};
+
+struct PartyRecord {
+    uint64_t players[5];
+};
+
+struct ConfigSnapshot {
+    int min_time;
+    int max_time;
+    uint64_t version;
+};
+
+// Michael-Scott queue of player nodes. Dequeue reads head and head->next
+// under hazard slots 0 and 1 and retires the old dummy node. Links use the
+// default seq_cst ordering that reclaim.h requires of unlinking.
+template <typename Scheme>
+class LockFreePlayerQueue {
+private:
+    alignas(64) std::atomic<PlayerNode*> head;
+    alignas(64) std::atomic<PlayerNode*> tail;
+
+public:
+    LockFreePlayerQueue() {
+        PlayerNode* dummy = new PlayerNode{0, 0};
+        head.store(dummy);
+        tail.store(dummy);
+    }
+
+    ~LockFreePlayerQueue() {
+        PlayerNode* node = head.load();
+        while (node != nullptr) {
+            PlayerNode* next = node->next.load();
+            delete node;
+            node = next;
+        }
+    }
+
+    LockFreePlayerQueue(const LockFreePlayerQueue&) = delete;
+    LockFreePlayerQueue& operator=(const LockFreePlayerQueue&) = delete;
+
+    void push(typename Scheme::Thread& thread, uint64_t player, int role) {
+        PlayerNode* node = new PlayerNode{player, role};
+        while (true) {
+            PlayerNode* last = thread.protect(0, tail);
+            PlayerNode* next = last->next.load(std::memory_order_acquire);
+            if (next != nullptr) {
+                tail.compare_exchange_weak(last, next);
+                continue;
+            }
+            if (last->next.compare_exchange_weak(next, node)) {
+                tail.compare_exchange_strong(last, node);
+                return;
+            }
+        }
+    }
+
+    bool pop(typename Scheme::Thread& thread, uint64_t& player) {
+        while (true) {
+            PlayerNode* first = thread.protect(0, head);
+            PlayerNode* next = thread.protect(1, first->next);
+            if (head.load(std::memory_order_acquire) != first) {
+                continue;
+            }
+            if (next == nullptr) {
+                return false;
+            }
+            PlayerNode* last = tail.load(std::memory_order_acquire);
+            if (first == last) {
+                tail.compare_exchange_weak(last, next);
+                continue;
+            }
+            uint64_t value = next->player;
+            if (head.compare_exchange_weak(first, next)) {
+                player = value;
+                thread.retire(first);
+                return true;
+            }
+        }
+    }
+};
+
+struct ReclaimRun {
+    double ns_per_op{0.0};
+    long long retired{0};
+    size_t peak_garbage{0};
+    long long checksum{0};
+};
+
+// Each operation enqueues and dequeues a player and reads the current config
+// snapshot; every fifth dequeued player publishes a party record and thread 0
+// replaces the config snapshot every 1024 operations. The optional reader
+// takes a party record inside its critical section and holds it until the
+// workers are done.
+template <typename Scheme>
+ReclaimRun runReclaimScheme(int threads, long long operations, bool stalled_reader) {
+    Scheme scheme;
+    LockFreePlayerQueue<Scheme> queue;
+    std::atomic<PartyRecord*> last_party{new PartyRecord{}};
+    std::atomic<ConfigSnapshot*> config{new ConfigSnapshot{1, 5, 0}};
+    std::atomic<bool> reader_ready{false};
+    std::atomic<bool> stop{false};
+    std::atomic<long long> retired{0};
+    std::atomic<long long> checksum{0};
+    std::atomic<size_t> peak{0};
+    ReclaimRun run;
+
+    std::thread reader;
+    if (stalled_reader) {
+        reader = std::thread([&]() {
+            typename Scheme::Thread thread(scheme);
+            thread.enter();
+            PartyRecord* party = thread.protect(3, last_party);
+            checksum.fetch_add(static_cast<long long>(party->players[0]), std::memory_order_relaxed);
+            reader_ready.store(true, std::memory_order_release);
+            while (!stop.load(std::memory_order_acquire)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            thread.exit();
+        });
+        while (!reader_ready.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    long long share = operations / threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            typename Scheme::Thread thread(scheme);
+            PartyRecord party{};
+            int filled = 0;
+            long long local_retired = 0;
+            long long local_checksum = 0;
+            for (long long i = 0; i < share; i++) {
+                thread.enter();
+                queue.push(thread, static_cast<uint64_t>(t * share + i), static_cast<int>(i % 3));
+                uint64_t player;
+                if (queue.pop(thread, player)) {
+                    local_retired++;
+                    party.players[filled++] = player;
+                }
+                ConfigSnapshot* current = thread.protect(2, config);
+                local_checksum += current->max_time - current->min_time;
+                if (filled == 5) {
+                    filled = 0;
+                    thread.retire(last_party.exchange(new PartyRecord(party)));
+                    local_retired++;
+                }
+                if (t == 0 && (i & 1023) == 1023) {
+                    ConfigSnapshot* next = new ConfigSnapshot{1, 5, current->version + 1};
+                    thread.retire(config.exchange(next));
+                    local_retired++;
+                    size_t garbage = scheme.pending();
+                    if (garbage > peak.load(std::memory_order_relaxed)) {
+                        peak.store(garbage, std::memory_order_relaxed);
+                    }
+                }
+                thread.exit();
+            }
+            retired.fetch_add(local_retired, std::memory_order_relaxed);
+            checksum.fetch_add(local_checksum, std::memory_order_relaxed);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    run.peak_garbage = std::max(peak.load(), scheme.pending());
+    stop.store(true, std::memory_order_release);
+    if (reader.joinable()) {
+        reader.join();
+    }
+
+    delete last_party.load();
+    delete config.load();
+    run.ns_per_op = std::chrono::duration<double, std::nano>(elapsed).count() / (share * threads);
+    run.retired = retired.load();
+    run.checksum = checksum.load();
+    return run;
+}
+
+// Single-threaded cost of a critical section, a protected load and replacing
+// a shared node and retiring the old one, in ns per call.
+template <typename Scheme>
+std::array<double, 3> reclaimCallCosts(long long calls, long long& checksum) {
+    Scheme scheme;
+    typename Scheme::Thread thread(scheme);
+    std::atomic<PlayerNode*> source{new PlayerNode{1, 0}};
+    std::array<double, 3> costs{};
+    auto perCall = [calls](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < calls; i++) {
+        thread.enter();
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        thread.exit();
+    }
+    costs[0] = perCall(start);
+
+    start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < calls; i++) {
+        checksum += static_cast<long long>(thread.protect(0, source)->player);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    costs[1] = perCall(start);
+    thread.exit();
+
+    start = std::chrono::steady_clock::now();
+    for (long long i = 0; i < calls; i++) {
+        thread.enter();
+        thread.retire(source.exchange(new PlayerNode{static_cast<uint64_t>(i), 0}));
+        thread.exit();
+    }
+    costs[2] = perCall(start);
+    delete source.load();
+    return costs;
+}
+
+// Compares the cost of retiring player nodes, party records and config
+// snapshots through epochs and hazard pointers against keeping everything
+// until the run ends, then stalls one reader to show how much garbage each
+// scheme lets build up.
+void runReclaimBenchmark(int threads, long long operations) {
+    // Every worker and the stalled reader register with the domains.
+    int limit = std::min(EpochDomain::max_threads, HazardDomain::max_threads) - 1;
+    if (threads > limit) {
+        std::cout << "Using " << limit << " worker threads, the most the reclamation domains can register."
+                  << std::endl;
+        threads = limit;
+    }
+    long long checksum = 0;
+    double baseline_ns = 0.0;
+    auto row = [&](const char* name, const ReclaimRun& run) {
+        std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << run.ns_per_op << std::showpos << std::setw(12) << run.ns_per_op - baseline_ns
+                  << std::noshowpos << std::setw(12) << run.retired << std::setw(14) << run.peak_garbage
+                  << std::setw(12) << run.peak_garbage * (sizeof(PlayerNode) + sizeof(RetiredObject)) / 1024 << std::endl;
+        checksum += run.checksum;
+    };
+    auto header = [&]() {
+        std::cout << std::left << std::setw(26) << "Scheme" << std::right << std::setw(10) << "ns/op" << std::setw(12)
+                  << "vs keep" << std::setw(12) << "retired" << std::setw(14) << "peak garbage" << std::setw(12)
+                  << "~KiB" << std::endl;
+    };
+
+    std::cout << "\n=== RECLAMATION BENCHMARK ===" << std::endl;
+    std::cout << "Per call on one thread, ns:" << std::endl;
+    std::cout << std::left << std::setw(26) << "Scheme" << std::right << std::setw(14) << "enter+exit"
+              << std::setw(16) << "protected load" << std::setw(18) << "replace + retire" << std::endl;
+    auto costRow = [&](const char* name, const std::array<double, 3>& costs) {
+        std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(14) << costs[0] << std::setw(16) << costs[1] << std::setw(18) << costs[2] << std::endl;
+    };
+    costRow("plain (delete at once)", reclaimCallCosts<ImmediateFree>(operations, checksum));
+    costRow("epochs", reclaimCallCosts<EpochReclaim>(operations, checksum));
+    costRow("hazard pointers", reclaimCallCosts<HazardReclaim>(operations, checksum));
+
+    std::cout << "\nShared queue, " << threads << " worker thread(s), " << operations
+              << " operations: enqueue and dequeue a player node and read the config snapshot;" << std::endl;
+    std::cout << "a party record is published every 5 players and the config snapshot replaced every 1024 operations"
+              << std::endl;
+
+    header();
+    ReclaimRun baseline = runReclaimScheme<FreeAtExit>(threads, operations, false);
+    baseline_ns = baseline.ns_per_op;
+    row("free when the run ends", baseline);
+    row("epochs", runReclaimScheme<EpochReclaim>(threads, operations, false));
+    row("hazard pointers", runReclaimScheme<HazardReclaim>(threads, operations, false));
+
+    std::cout << "\nOne reader stalled inside its critical section for the whole run:" << std::endl;
+    header();
+    row("epochs", runReclaimScheme<EpochReclaim>(threads, operations, true));
+    row("hazard pointers", runReclaimScheme<HazardReclaim>(threads, operations, true));
+    std::cout << "Hazard-pointer garbage is bounded by "
+              << HazardDomain::scanThreshold() + HazardDomain::max_threads * HazardDomain::slots_per_thread
+              << " objects per thread." << std::endl;
+    std::cout << "Checksum: " << checksum << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    long long threads = std::max(1u, std::thread::hardware_concurrency());
+    long long operations = 1000000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--threads", value)) {
+            if (!parseCount(value, 1, INT_MAX, threads)) {
+                std::cerr << "Invalid --threads: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--operations", value)) {
+            if (!parseCount(value, 1, LLONG_MAX, operations)) {
+                std::cerr << "Invalid --operations: " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--threads=N] [--operations=N]" << std::endl;
+            return 1;
+        }
+    }
+    runReclaimBenchmark(static_cast<int>(threads), operations);
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "bulkRandom.h"
+#include "instanceTables.h"
+#include "perfCounters.h"
+#include "queueStore.h"
+#include "toolOptions.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+#include <sys/resource.h>
+
+// Measures what huge pages buy the queue store (queueStore.h): the same access
+// patterns on 4 KiB, transparent huge and hugetlbfs pages.
+
+// Times the queue and instance-table access patterns on a store backed by
+// 4 KiB pages, transparent huge pages and hugetlbfs pages, with data-TLB
+// miss and page-fault counts per operation.
+void runTlbBenchmark(long long operations, uint32_t instances, int batch_capacity_log2) {
+    const uint32_t capacity = 1u << batch_capacity_log2;
+    const PageMode modes[3]{PageMode::normal, PageMode::transparent, PageMode::hugetlb};
+    long long checksum = 0;
+
+    std::cout << "\n=== TLB BENCHMARK ===" << std::endl;
+    std::cout << instances << " instances, " << capacity << " queued batches per role, " << operations
+              << " random operations per pattern" << std::endl;
+
+    for (PageMode requested : modes) {
+        QueueStore store(instances, capacity, requested);
+        PageMode mode = store.pageMode();
+        std::cout << "\n" << pageModeName(requested) << " pages";
+        if (mode != requested) {
+            std::cout << " (unavailable, using " << pageModeName(mode) << ")";
+        }
+        std::cout << ": " << (store.imageBytes() >> 20) << " MiB image" << std::endl;
+        std::cout << std::left << std::setw(26) << "Pattern" << std::right << std::setw(12) << "ns/op"
+                  << std::setw(18) << "dTLB misses/op" << std::setw(14) << "page faults" << std::endl;
+
+        // Page faults come from getrusage, which also counts the ones
+        // MADV_POPULATE_WRITE takes on our behalf.
+        auto minorFaults = []() {
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return static_cast<long long>(usage.ru_minflt);
+        };
+        long long faults_before = 0;
+        auto row = [&](const char* name, const PerfCounterGroup& counters, std::chrono::steady_clock::duration elapsed,
+                       long long count) {
+            long long load_misses = counters.value("dTLB-load-misses");
+            long long store_misses = counters.value("dTLB-store-misses");
+            std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << std::chrono::duration<double, std::nano>(elapsed).count() / count;
+            if (load_misses >= 0 && store_misses >= 0) {
+                std::cout << std::setw(18) << static_cast<double>(load_misses + store_misses) / count;
+            } else {
+                std::cout << std::setw(18) << "n/a";
+            }
+            std::cout << std::setw(14) << minorFaults() - faults_before << std::endl;
+        };
+
+        PerfCounterGroup counters(true);
+        faults_before = minorFaults();
+        counters.start();
+        auto start = std::chrono::steady_clock::now();
+        bool populated = store.prefault(0, store.imageBytes());
+        counters.stop();
+        row(populated ? "prefault (per MiB)" : "prefault unsupported", counters, std::chrono::steady_clock::now() - start,
+            std::max<long long>(static_cast<long long>(store.imageBytes() >> 20), 1));
+
+        BulkRandom rng(1);
+        faults_before = minorFaults();
+        counters.start();
+        start = std::chrono::steady_clock::now();
+        for (int role = 0; role < 3; role++) {
+            for (uint32_t i = 0; i < capacity; i++) {
+                store.enqueue(role, 1 + static_cast<int>(i & 3), i);
+            }
+        }
+        counters.stop();
+        row("fill queues", counters, std::chrono::steady_clock::now() - start, 3LL * capacity);
+
+        faults_before = minorFaults();
+        counters.start();
+        start = std::chrono::steady_clock::now();
+        for (int role = 0; role < 3; role++) {
+            for (size_t i = 0; i < store.batchCount(role); i++) {
+                checksum += store.batch(role, i).count;
+            }
+        }
+        counters.stop();
+        row("scan queues", counters, std::chrono::steady_clock::now() - start, 3LL * capacity);
+
+        faults_before = minorFaults();
+        counters.start();
+        start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < operations; i++) {
+            checksum += store.batch(static_cast<int>(i % 3), rng.below(capacity)).arrived_us;
+        }
+        counters.stop();
+        row("random batch reads", counters, std::chrono::steady_clock::now() - start, operations);
+
+        faults_before = minorFaults();
+        counters.start();
+        start = std::chrono::steady_clock::now();
+        int* parties_served = store.partiesServed();
+        int* time_served = store.timeServed();
+        for (long long i = 0; i < operations; i++) {
+            uint32_t instance = rng.below(instances);
+            parties_served[instance]++;
+            time_served[instance] += 1 + (parties_served[instance] & 3);
+        }
+        counters.stop();
+        row("random instance updates", counters, std::chrono::steady_clock::now() - start, operations);
+
+        long long huge = hugePageBytes(store.imageAddress(), store.imageBytes());
+        if (huge >= 0) {
+            std::cout << "Backed by huge pages: " << (huge >> 20) << " of " << (store.imageBytes() >> 20) << " MiB"
+                      << std::endl;
+        }
+    }
+    std::cout << "\nChecksum: " << checksum << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    long long operations = 20000000;
+    long long instances = 1 << 24;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--operations", value)) {
+            if (!parseCount(value, 1, LLONG_MAX, operations)) {
+                std::cerr << "Invalid --operations: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--instances", value)) {
+            if (!parseCount(value, 1, 1 << 30, instances)) {
+                std::cerr << "Invalid --instances: " << value << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--operations=N] [--instances=N]" << std::endl;
+            return 1;
+        }
+    }
+    runTlbBenchmark(operations, static_cast<uint32_t>(instances), 22);
+    return 0;
+}
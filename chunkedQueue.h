@@ -0,0 +1,285 @@
+#ifndef CHUNKED_QUEUE_H
+#define CHUNKED_QUEUE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+ * Fixed-size blocks handed out from slabs and recycled through a free list.
+ * Freed blocks are reused most-recently-freed first, so a queue that keeps
+ * draining and refilling touches the same few cache-warm blocks. Every block
+ * has a permanent 32-bit id (Block must have a uint32_t id member), so owners
+ * can refer to it in less space than a pointer. Memory goes back to the
+ * system only when the pool is destroyed.
+ */
+template <typename Block>
+class BlockPool {
+private:
+    static constexpr size_t blocks_per_slab = 64;
+    static constexpr size_t alignment = 64;
+
+    std::vector<void*> slabs;
+    std::vector<Block*> blocks;
+    std::vector<Block*> free_blocks;
+
+public:
+    BlockPool() = default;
+
+    ~BlockPool() {
+        for (void* slab : slabs) {
+            std::free(slab);
+        }
+    }
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // Makes sure the next count acquire() calls cannot fail.
+    void reserve(size_t count) {
+        while (free_blocks.size() < count) {
+            size_t block_bytes = (sizeof(Block) + alignment - 1) / alignment * alignment;
+            void* slab = std::aligned_alloc(alignment, block_bytes * blocks_per_slab);
+            if (slab == nullptr) {
+                throw std::bad_alloc();
+            }
+            slabs.push_back(slab);
+            blocks.reserve(blocks.size() + blocks_per_slab);
+            free_blocks.reserve(free_blocks.size() + blocks_per_slab);
+            for (size_t i = 0; i < blocks_per_slab; i++) {
+                Block* block = reinterpret_cast<Block*>(static_cast<char*>(slab) + i * block_bytes);
+                block->id = static_cast<uint32_t>(blocks.size());
+                blocks.push_back(block);
+            }
+            for (size_t i = blocks_per_slab; i-- > 0;) {
+                free_blocks.push_back(blocks[blocks.size() - blocks_per_slab + i]);
+            }
+        }
+    }
+
+    Block* acquire() {
+        reserve(1);
+        Block* block = free_blocks.back();
+        free_blocks.pop_back();
+        return block;
+    }
+
+    void release(Block* block) {
+        free_blocks.push_back(block);
+    }
+
+    Block* at(uint32_t id) const {
+        return blocks[id];
+    }
+
+    size_t slabCount() const {
+        return slabs.size();
+    }
+};
+
+/*
+ * A FIFO of trivially copyable entries stored in a ring of pool blocks of
+ * BlockEntries slots each. Cancelling an entry only sets its tombstone bit;
+ * pops skip tombstones a 64-bit word at a time, and once tombstones take up
+ * half of the slots compact() rewrites the live entries into fresh blocks.
+ * Traversal therefore streams through a few contiguous blocks instead of
+ * chasing per-entry nodes.
+ */
+template <typename T, uint32_t BlockEntries = 256>
+class ChunkedQueue {
+    static_assert(BlockEntries % 64 == 0 && (BlockEntries & (BlockEntries - 1)) == 0,
+                  "BlockEntries must be a power of two of at least 64");
+
+public:
+    struct Block {
+        uint64_t dead[BlockEntries / 64];
+        uint32_t begin;
+        uint32_t end;
+        uint32_t id;
+        T entries[BlockEntries];
+    };
+
+    // Where an entry lives, as pool block id * BlockEntries + slot; valid
+    // until the entry is popped or moved by compact().
+    struct Handle {
+        uint32_t value;
+    };
+
+    using Pool = BlockPool<Block>;
+
+private:
+    Pool& pool;
+    std::vector<Block*> ring;
+    size_t head{0};
+    size_t block_count{0};
+    size_t live{0};
+    size_t dead{0};
+
+    Block* blockAt(size_t i) const {
+        return ring[(head + i) & (ring.size() - 1)];
+    }
+
+    void reserveRing(size_t count) {
+        if (count <= ring.size()) {
+            return;
+        }
+        size_t capacity = std::max<size_t>(ring.size(), 8);
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        std::vector<Block*> grown(capacity);
+        for (size_t i = 0; i < block_count; i++) {
+            grown[i] = blockAt(i);
+        }
+        ring.swap(grown);
+        head = 0;
+    }
+
+    void pushBlock() {
+        reserveRing(block_count + 1);
+        Block* block = pool.acquire();
+        block->begin = 0;
+        block->end = 0;
+        for (auto& word : block->dead) {
+            word = 0;
+        }
+        ring[(head + block_count) & (ring.size() - 1)] = block;
+        block_count++;
+    }
+
+    void popBlock() {
+        pool.release(blockAt(0));
+        head = (head + 1) & (ring.size() - 1);
+        block_count--;
+    }
+
+    static bool isDead(const Block* block, uint32_t index) {
+        return (block->dead[index / 64] >> (index % 64)) & 1;
+    }
+
+    // Finds the oldest live entry, releasing exhausted blocks and counting
+    // skipped tombstones out of dead; the head block's begin is left for the
+    // caller to store. Slots past end have no tombstone bit, so one
+    // count-trailing-zeros over the inverted word jumps a whole run of
+    // tombstones without a branch per entry.
+    Block* skipDead(uint32_t& index) {
+        Block* block = blockAt(0);
+        index = block->begin;
+        while (true) {
+            if (index < block->end) {
+                uint32_t bit = index % 64;
+                uint64_t alive = ~(block->dead[index / 64] >> bit);
+                uint32_t skip = alive == 0 ? 64 : static_cast<uint32_t>(__builtin_ctzll(alive));
+                index += skip;
+                dead -= skip;
+                if (skip < 64 - bit && index < block->end) {
+                    return block;
+                }
+                continue;
+            }
+            popBlock();
+            block = blockAt(0);
+            index = block->begin;
+            __builtin_prefetch(&block->entries[index]);
+        }
+    }
+
+public:
+    explicit ChunkedQueue(Pool& block_pool) : pool(block_pool) {}
+
+    ~ChunkedQueue() {
+        while (block_count > 0) {
+            popBlock();
+        }
+    }
+
+    ChunkedQueue(const ChunkedQueue&) = delete;
+    ChunkedQueue& operator=(const ChunkedQueue&) = delete;
+
+    Handle push(const T& entry) {
+        if (block_count == 0 || blockAt(block_count - 1)->end == BlockEntries) {
+            pushBlock();
+        }
+        Block* block = blockAt(block_count - 1);
+        uint32_t index = block->end++;
+        block->entries[index] = entry;
+        live++;
+        return {block->id * BlockEntries + index};
+    }
+
+    bool empty() const {
+        return live == 0;
+    }
+
+    size_t size() const {
+        return live;
+    }
+
+    size_t tombstones() const {
+        return dead;
+    }
+
+    size_t blocks() const {
+        return block_count;
+    }
+
+    // Removes and returns the oldest live entry; the queue must not be empty.
+    T popFront() {
+        uint32_t index;
+        Block* block = skipDead(index);
+        T entry = block->entries[index++];
+        block->begin = index;
+        live--;
+        if (index == BlockEntries / 2 && block_count > 1) {
+            __builtin_prefetch(&blockAt(1)->entries[0]);
+        }
+        if (index == BlockEntries || (index == block->end && live == 0)) {
+            popBlock();
+        }
+        return entry;
+    }
+
+    // Tombstones the entry at handle, which must be live.
+    void cancel(Handle handle) {
+        uint32_t index = handle.value % BlockEntries;
+        pool.at(handle.value / BlockEntries)->dead[index / 64] |= uint64_t{1} << (index % 64);
+        live--;
+        dead++;
+    }
+
+    bool shouldCompact() const {
+        return dead >= 4 * BlockEntries && dead >= live;
+    }
+
+    // Rewrites the live entries into fresh blocks in the same order, calling
+    // moved(entry, new_handle) for each so owners can update their handles.
+    // Memory is reserved first: a bad_alloc leaves the queue untouched.
+    template <typename F>
+    void compact(F&& moved) {
+        size_t old_count = block_count;
+        pool.reserve(live / BlockEntries + 1);
+        reserveRing(block_count + 1);
+        for (size_t i = 0; i < old_count; i++) {
+            Block* block = blockAt(0);
+            for (uint32_t index = block->begin; index < block->end; index++) {
+                if (!isDead(block, index)) {
+                    if (block_count == old_count - i || blockAt(block_count - 1)->end == BlockEntries) {
+                        pushBlock();
+                    }
+                    Block* target = blockAt(block_count - 1);
+                    uint32_t slot = target->end++;
+                    target->entries[slot] = block->entries[index];
+                    moved(target->entries[slot], Handle{target->id * BlockEntries + slot});
+                }
+            }
+            popBlock();
+        }
+        dead = 0;
+    }
+};
+
+#endif
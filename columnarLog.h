@@ -0,0 +1,72 @@
+#ifndef COLUMNAR_LOG_H
+#define COLUMNAR_LOG_H
+
+#include <cstdint>
+
+/*
+ * On-disk layout of the columnar event log written by dungeonManagerProducer
+ * (--event-log) and read by eventQuery. A file is a 64-byte header followed
+ * by blocks of up to columnar_block_rows rows. Each block starts with a
+ * ColumnarBlockHeader and stores every column as one contiguous array that
+ * begins on a 64-byte boundary and is padded to the next one, so a reader
+ * can map the file and touch only the columns a query needs. The min/max
+ * timestamps let readers skip whole blocks. A trailing block that is
+ * shorter than its declared size was cut off by a crash and is ignored.
+ */
+
+constexpr char columnar_magic[8]{'D', 'M', 'C', 'O', 'L', 'L', 'O', 'G'};
+constexpr uint32_t columnar_version = 1;
+constexpr uint32_t columnar_block_rows = 65536;
+
+enum ColumnarKind : uint8_t {
+    COLUMNAR_MATCHED = 0,
+    COLUMNAR_EXPIRED = 1,
+    COLUMNAR_CANCELLED = 2
+};
+
+enum ColumnarColumn {
+    COLUMN_TIMESTAMP_US = 0,  /* int64: Unix time of the event in microseconds */
+    COLUMN_WAIT_MS = 1,       /* float: time the player spent queued */
+    COLUMN_KIND = 2,          /* uint8: ColumnarKind */
+    COLUMN_ROLE = 3,          /* uint8: 0 tank, 1 healer, 2 DPS */
+    COLUMN_REGION = 4,        /* uint16 */
+    COLUMN_COUNT = 5
+};
+
+constexpr uint32_t columnar_widths[COLUMN_COUNT]{8, 4, 1, 1, 2};
+
+struct ColumnarFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_rows;
+    uint8_t reserved[48];
+};
+
+struct ColumnarBlockHeader {
+    uint64_t block_bytes;
+    uint32_t rows;
+    uint32_t reserved;
+    int64_t min_timestamp_us;
+    int64_t max_timestamp_us;
+    uint64_t column_offset[COLUMN_COUNT];
+};
+
+static_assert(sizeof(ColumnarFileHeader) == 64, "blocks must start on a 64-byte boundary");
+
+inline uint64_t columnarAlign(uint64_t offset) {
+    return (offset + 63) & ~uint64_t{63};
+}
+
+/* Fills in the column offsets (relative to the block start) and block size. */
+inline void columnarLayout(ColumnarBlockHeader& header, uint32_t rows) {
+    uint64_t offset = columnarAlign(sizeof(ColumnarBlockHeader));
+    for (int column = 0; column < COLUMN_COUNT; column++) {
+        header.column_offset[column] = offset;
+        offset = columnarAlign(offset + static_cast<uint64_t>(columnar_widths[column]) * rows);
+    }
+    header.rows = rows;
+    header.reserved = 0;
+    header.block_bytes = offset;
+}
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef DD_SKETCH_H
+#define DD_SKETCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * DDSketch: positive values are counted in logarithmic buckets, so every
+ * quantile is returned within `relative_accuracy` of a true sample value.
+ * Sketches with the same accuracy merge by adding bucket counts, which makes
+ * a merge of shard, instance or per-run sketches exactly as accurate as one
+ * sketch fed every value. Values at or below zero_threshold (e.g. players
+ * matched on arrival) go to a separate zero bucket. When more than
+ * max_buckets are needed the lowest buckets are folded together, which only
+ * costs accuracy in the low quantiles.
+ */
+class DDSketch {
+private:
+    static constexpr double zero_threshold = 1e-9;
+    // Folding needs room for at least a few buckets.
+    static constexpr uint32_t min_buckets = 16;
+
+    double accuracy;
+    double gamma;
+    double log_gamma;
+    uint32_t max_buckets;
+    int32_t offset{0};
+    std::vector<uint64_t> bins;
+    uint64_t zero_count{0};
+    uint64_t total{0};
+    double minimum{std::numeric_limits<double>::infinity()};
+    double maximum{-std::numeric_limits<double>::infinity()};
+    double total_sum{0.0};
+
+    int32_t keyOf(double value) const {
+        return static_cast<int32_t>(std::ceil(std::log(value) / log_gamma));
+    }
+
+    double valueOf(int32_t key) const {
+        return 2.0 * std::pow(gamma, key) / (gamma + 1.0);
+    }
+
+    void addToKey(int32_t key, uint64_t count) {
+        if (bins.empty()) {
+            offset = key;
+            bins.push_back(0);
+        } else if (key < offset) {
+            bins.insert(bins.begin(), static_cast<size_t>(offset - key), 0);
+            offset = key;
+        } else if (key >= offset + static_cast<int32_t>(bins.size())) {
+            bins.resize(static_cast<size_t>(key - offset) + 1, 0);
+        }
+        bins[static_cast<size_t>(key - offset)] += count;
+
+        if (bins.size() > max_buckets) {
+            size_t folded = bins.size() - max_buckets;
+            uint64_t low = 0;
+            for (size_t i = 0; i <= folded; i++) {
+                low += bins[i];
+            }
+            bins.erase(bins.begin(), bins.begin() + static_cast<std::ptrdiff_t>(folded));
+            bins[0] = low;
+            offset += static_cast<int32_t>(folded);
+        }
+    }
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static bool take(const char*& cursor, const char* end, T& value) {
+        if (end - cursor < static_cast<std::ptrdiff_t>(sizeof(value))) {
+            return false;
+        }
+        std::memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
+        return true;
+    }
+
+public:
+    explicit DDSketch(double relative_accuracy = 0.01, uint32_t bucket_limit = 2048)
+        : accuracy(relative_accuracy), gamma((1.0 + relative_accuracy) / (1.0 - relative_accuracy)),
+          log_gamma(std::log(gamma)), max_buckets(std::max(bucket_limit, min_buckets)) {}
+
+    void add(double value, uint64_t count = 1) {
+        if (count == 0) {
+            return;
+        }
+        if (value <= zero_threshold) {
+            zero_count += count;
+        } else {
+            addToKey(keyOf(value), count);
+        }
+        total += count;
+        minimum = std::min(minimum, value);
+        maximum = std::max(maximum, value);
+        total_sum += value * count;
+    }
+
+    // Adds other's counts; false (and nothing merged) if the accuracies differ.
+    bool merge(const DDSketch& other) {
+        if (other.accuracy != accuracy) {
+            return false;
+        }
+        for (size_t i = 0; i < other.bins.size(); i++) {
+            if (other.bins[i] > 0) {
+                addToKey(other.offset + static_cast<int32_t>(i), other.bins[i]);
+            }
+        }
+        zero_count += other.zero_count;
+        total += other.total;
+        minimum = std::min(minimum, other.minimum);
+        maximum = std::max(maximum, other.maximum);
+        total_sum += other.total_sum;
+        return true;
+    }
+
+    // Returns the value at rank ceil(q * count), clamped to the observed range.
+    double quantile(double q) const {
+        if (total == 0) {
+            return 0.0;
+        }
+        uint64_t rank = static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * total));
+        rank = std::max<uint64_t>(rank, 1);
+        uint64_t seen = zero_count;
+        if (seen >= rank) {
+            return std::max(0.0, minimum);
+        }
+        for (size_t i = 0; i < bins.size(); i++) {
+            seen += bins[i];
+            if (seen >= rank) {
+                return std::clamp(valueOf(offset + static_cast<int32_t>(i)), minimum, maximum);
+            }
+        }
+        return maximum;
+    }
+
+    bool empty() const {
+        return total == 0;
+    }
+
+    uint64_t count() const {
+        return total;
+    }
+
+    double mean() const {
+        return total > 0 ? total_sum / total : 0.0;
+    }
+
+    double relativeAccuracy() const {
+        return accuracy;
+    }
+
+    size_t bucketCount() const {
+        return bins.size();
+    }
+
+    uint32_t bucketLimit() const {
+        return max_buckets;
+    }
+
+    // Native-endian binary encoding: the parameters and totals followed by
+    // the contiguous bucket counts.
+    void serialize(std::string& out) const {
+        put(out, accuracy);
+        put(out, max_buckets);
+        put(out, offset);
+        put(out, static_cast<uint32_t>(bins.size()));
+        put(out, zero_count);
+        put(out, total);
+        put(out, minimum);
+        put(out, maximum);
+        put(out, total_sum);
+        out.append(reinterpret_cast<const char*>(bins.data()), bins.size() * sizeof(uint64_t));
+    }
+
+    // Rejects a bucket limit the constructor would not allow and more bins
+    // than the limit, which later adds would fold out of bounds.
+    bool deserialize(const char*& cursor, const char* end) {
+        uint32_t bin_count = 0;
+        if (!take(cursor, end, accuracy) || !take(cursor, end, max_buckets) || !take(cursor, end, offset) ||
+            !take(cursor, end, bin_count) || !take(cursor, end, zero_count) || !take(cursor, end, total) ||
+            !take(cursor, end, minimum) || !take(cursor, end, maximum) || !take(cursor, end, total_sum) ||
+            !(accuracy > 0.0 && accuracy < 1.0) || max_buckets < min_buckets || bin_count > max_buckets ||
+            static_cast<uint64_t>(end - cursor) < static_cast<uint64_t>(bin_count) * sizeof(uint64_t)) {
+            return false;
+        }
+        gamma = (1.0 + accuracy) / (1.0 - accuracy);
+        log_gamma = std::log(gamma);
+        bins.resize(bin_count);
+        std::memcpy(bins.data(), cursor, bin_count * sizeof(uint64_t));
+        cursor += bin_count * sizeof(uint64_t);
+        return true;
+    }
+};
+
+/*
+ * A sketch file holds named sketches (e.g. "wait.dps", "duration.instance.7"):
+ * the magic "DDSKSET1", a uint32 count, then per sketch a uint16 name length,
+ * the name and the serialized sketch.
+ */
+using NamedSketches = std::vector<std::pair<std::string, DDSketch>>;
+
+constexpr char sketch_set_magic[8]{'D', 'D', 'S', 'K', 'S', 'E', 'T', '1'};
+
+inline std::string serializeSketches(const NamedSketches& sketches) {
+    std::string out(sketch_set_magic, sizeof(sketch_set_magic));
+    uint32_t count = static_cast<uint32_t>(sketches.size());
+    out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& [name, sketch] : sketches) {
+        uint16_t length = static_cast<uint16_t>(std::min<size_t>(name.size(), 65535));
+        out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        out.append(name.data(), length);
+        sketch.serialize(out);
+    }
+    return out;
+}
+
+inline bool parseSketches(const std::string& data, NamedSketches& sketches) {
+    const char* cursor = data.data();
+    const char* end = cursor + data.size();
+    uint32_t count = 0;
+    if (data.size() < sizeof(sketch_set_magic) + sizeof(count) ||
+        std::memcmp(cursor, sketch_set_magic, sizeof(sketch_set_magic)) != 0) {
+        return false;
+    }
+    cursor += sizeof(sketch_set_magic);
+    std::memcpy(&count, cursor, sizeof(count));
+    cursor += sizeof(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t length = 0;
+        if (end - cursor < static_cast<std::ptrdiff_t>(sizeof(length))) {
+            return false;
+        }
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (end - cursor < length) {
+            return false;
+        }
+        std::string name(cursor, length);
+        cursor += length;
+        DDSketch sketch;
+        if (!sketch.deserialize(cursor, end)) {
+            return false;
+        }
+        sketches.emplace_back(std::move(name), std::move(sketch));
+    }
+    return cursor == end;
+}
+
+#endif
@@ -7,9 +7,12 @@
 #include <chrono>
 #include <atomic>
 #include <iomanip>
+#include <algorithm>
 #include <sstream>
 #include <cctype>
 
+#include "instanceTables.h"
+
 class DungeonManager {
 private:
     std::mutex mtx;
@@ -20,23 +23,61 @@ private:
     int dps_queue;
     
     int dungeon_count;
-    std::vector<bool> dungeon_active;
-    std::vector<int> parties_served;
-    std::vector<int> total_time_served;
+    LazyInstanceArray<unsigned char> dungeon_active;
+    LazyInstanceArray<int> parties_served;
+    LazyInstanceArray<int> total_time_served;
+    
+    std::vector<std::thread> workers;
+    int idle_workers{0};
+    std::vector<int> free_instances;
+    int next_instance{0};
+    int min_dungeon_time{0};
+    int max_dungeon_time{0};
+    std::vector<std::thread> prefault_threads;
     
-    std::random_device rd;
-    std::mt19937 gen;
+    std::chrono::steady_clock::time_point created_at;
+    std::chrono::steady_clock::time_point first_party_at;
+    bool first_party_formed{false};
+    
+    std::atomic<uint64_t> next_seed;
     
     std::atomic<int> total_parties_formed{0};
     std::atomic<int> total_players_added{0};
     bool shutdown{false};
+    bool full_status{false};
+    static constexpr int summary_rank_count = 5;
 
 public:
     DungeonManager(int n, int t, int h, int d) 
-        : dungeon_count(n), tank_queue(t), healer_queue(h), dps_queue(d), gen(rd()) {
-        dungeon_active.resize(n, false);
-        parties_served.resize(n, 0);
-        total_time_served.resize(n, 0);
+        : tank_queue(t), healer_queue(h), dps_queue(d), dungeon_count(n),
+          dungeon_active(n), parties_served(n), total_time_served(n),
+          created_at(std::chrono::steady_clock::now()),
+          next_seed((static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}()) {
+    }
+
+    ~DungeonManager() {
+        for (auto& thread : prefault_threads) {
+            thread.join();
+        }
+    }
+
+    void prefaultInstanceState() {
+        int thread_count = std::max(1u, std::thread::hardware_concurrency());
+        size_t chunk = 1 << 20;
+        for (int worker = 0; worker < thread_count; worker++) {
+            prefault_threads.emplace_back([this, worker, thread_count, chunk]() {
+                size_t largest = std::max({dungeon_active.sizeInBytes(),
+                                           parties_served.sizeInBytes(),
+                                           total_time_served.sizeInBytes()});
+                for (size_t offset = worker * chunk; offset < largest; offset += thread_count * chunk) {
+                    if (!dungeon_active.prefault(offset, chunk) ||
+                        !parties_served.prefault(offset, chunk) ||
+                        !total_time_served.prefault(offset, chunk)) {
+                        return;
+                    }
+                }
+            });
+        }
     }
 
     bool canFormParty() {
@@ -48,6 +89,33 @@ public:
         healer_queue -= 1;
         dps_queue -= 3;
         total_parties_formed++;
+        
+        if (!first_party_formed) {
+            first_party_formed = true;
+            first_party_at = std::chrono::steady_clock::now();
+        }
+    }
+
+    int acquireInstance() {
+        if (!free_instances.empty()) {
+            int instance_id = free_instances.back();
+            free_instances.pop_back();
+            return instance_id;
+        }
+        return next_instance++;
+    }
+
+    void releaseInstance(int instance_id) {
+        free_instances.push_back(instance_id);
+    }
+
+    void ensureWorkers() {
+        int formable_parties = std::min({tank_queue, healer_queue, dps_queue / 3});
+        while (!shutdown && idle_workers < formable_parties &&
+               static_cast<int>(workers.size()) < dungeon_count) {
+            idle_workers++;
+            workers.emplace_back(&DungeonManager::dungeonInstance, this);
+        }
     }
 
     void addPlayersToQueue(int tanks, int healers, int dps) {
@@ -56,31 +124,85 @@ public:
         dps_queue += dps;
         total_players_added += (tanks + healers + dps);
         
+        ensureWorkers();
+        
         std::cout << "Producer: Added " << tanks << " tanks, " << healers 
                   << " healers, " << dps << " DPS to queue." << std::endl;
         
         cv.notify_all();
     }
 
+    void setFullStatus(bool enabled) {
+        full_status = enabled;
+    }
+
+    void printDistribution(const std::string& label, const std::vector<int>& values) {
+        InstanceDistribution summary = summarizeInstances(values, dungeon_count);
+        std::cout << label << " - min " << std::fixed << std::setprecision(1) << summary.min
+                  << ", q1 " << summary.q1 << ", median " << summary.median << ", q3 " << summary.q3
+                  << ", max " << summary.max << ", Gini " << std::setprecision(3) << summary.gini << std::endl;
+    }
+
+    void printInstanceRanking(const std::string& label, const std::vector<int>& served,
+                              const std::vector<int>& time_served, bool busiest) {
+        std::cout << label << ":";
+        for (int id : rankInstances(served, summary_rank_count, busiest)) {
+            std::cout << " " << (id + 1) << " (" << served[id] << " parties, " << time_served[id] << "s)";
+        }
+        std::cout << std::endl;
+    }
+
     void displayStatus() {
-        std::lock_guard<std::mutex> lock(mtx);
+        std::vector<unsigned char> active_snapshot;
+        std::vector<int> served_snapshot;
+        std::vector<int> time_snapshot;
+        int tanks, healers, dps;
+        
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            active_snapshot.assign(&dungeon_active[0], &dungeon_active[0] + next_instance);
+            served_snapshot.assign(&parties_served[0], &parties_served[0] + next_instance);
+            time_snapshot.assign(&total_time_served[0], &total_time_served[0] + next_instance);
+            tanks = tank_queue;
+            healers = healer_queue;
+            dps = dps_queue;
+        }
+        
+        int used_instances = static_cast<int>(active_snapshot.size());
         std::cout << "\n=== Current Instance Status ===" << std::endl;
-        for (int i = 0; i < dungeon_count; i++) {
-            std::cout << "Instance " << (i + 1) << ": " 
-                      << (dungeon_active[i] ? "ACTIVE" : "EMPTY") 
-                      << " | Parties served: " << parties_served[i] 
-                      << " | Total time: " << total_time_served[i] << "s" << std::endl;
+        if (full_status) {
+            for (int i = 0; i < dungeon_count; i++) {
+                bool used = i < used_instances;
+                std::cout << "Instance " << (i + 1) << ": " 
+                          << (used && active_snapshot[i] ? "ACTIVE" : "EMPTY") 
+                          << " | Parties served: " << (used ? served_snapshot[i] : 0) 
+                          << " | Total time: " << (used ? time_snapshot[i] : 0) << "s" << std::endl;
+            }
+        } else {
+            int active = static_cast<int>(std::count(active_snapshot.begin(), active_snapshot.end(), 1));
+            std::cout << "Instances: " << dungeon_count << " | Active: " << active
+                      << " | Never used: " << (dungeon_count - used_instances) << std::endl;
+            printDistribution("Parties served per instance", served_snapshot);
+            printDistribution("Time served per instance (s)", time_snapshot);
+            printInstanceRanking("Busiest", served_snapshot, time_snapshot, true);
+            printInstanceRanking("Least busy", served_snapshot, time_snapshot, false);
         }
-        std::cout << "Players in queue - Tanks: " << tank_queue
-                  << ", Healers: " << healer_queue
-                  << ", DPS: " << dps_queue << std::endl;
+        std::cout << "Players in queue - Tanks: " << tanks
+                  << ", Healers: " << healers
+                  << ", DPS: " << dps << std::endl;
         std::cout << "Total parties formed: " << total_parties_formed << std::endl;
         std::cout << "Total players added: " << total_players_added << std::endl;
         std::cout << "================================\n" << std::endl;
     }
 
-    void dungeonInstance(int instance_id, int t1, int t2) {
-        std::uniform_int_distribution<> time_dist(t1, t2);
+    // std::mt19937 is not thread-safe, so every thread draws from its own engine.
+    std::mt19937_64 makeThreadRng() {
+        return std::mt19937_64(next_seed.fetch_add(0x9e3779b97f4a7c15ULL, std::memory_order_relaxed));
+    }
+
+    void dungeonInstance() {
+        std::mt19937_64 instance_gen = makeThreadRng();
+        std::uniform_int_distribution<> time_dist(min_dungeon_time, max_dungeon_time);
         
         while (true) {
             std::unique_lock<std::mutex> lock(mtx);
@@ -95,6 +217,8 @@ public:
             
             if (canFormParty()) {
                 formParty();
+                idle_workers--;
+                int instance_id = acquireInstance();
                 dungeon_active[instance_id] = true;
                 parties_served[instance_id]++;
                 
@@ -103,12 +227,14 @@ public:
                 
                 lock.unlock();
                 
-                int dungeon_time = time_dist(gen);
+                int dungeon_time = time_dist(instance_gen);
                 std::this_thread::sleep_for(std::chrono::seconds(dungeon_time));
                 
                 lock.lock();
                 total_time_served[instance_id] += dungeon_time;
                 dungeon_active[instance_id] = false;
+                releaseInstance(instance_id);
+                idle_workers++;
                 
                 std::cout << "Instance " << (instance_id + 1) 
                           << ": Dungeon completed in " << dungeon_time << " seconds!" << std::endl;
@@ -119,10 +245,11 @@ public:
     }
 
     void startInstances(int t1, int t2) {
-        std::vector<std::thread> instances;
-        
-        for (int i = 0; i < dungeon_count; i++) {
-            instances.emplace_back(&DungeonManager::dungeonInstance, this, i, t1, t2);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            min_dungeon_time = t1;
+            max_dungeon_time = t2;
+            ensureWorkers();
         }
         
         auto start_time = std::chrono::steady_clock::now();
@@ -144,8 +271,8 @@ public:
             cv.notify_all();
         }
         
-        for (auto& instance : instances) {
-            instance.join();
+        for (auto& worker : workers) {
+            worker.join();
         }
         
         displayFinalSummary();
@@ -161,26 +288,58 @@ public:
         
         int total_parties = 0;
         int overall_time = 0;
-        
-        for (int i = 0; i < dungeon_count; i++) {
+        auto printRow = [this](int i) {
             std::cout << std::setw(10) << (i + 1) 
                       << std::setw(15) << (dungeon_active[i] ? "ACTIVE" : "EMPTY")
                       << std::setw(15) << parties_served[i] 
                       << std::setw(15) << total_time_served[i] << "s" << std::endl;
-            
-            total_parties += parties_served[i];
-            overall_time += total_time_served[i];
+        };
+        
+        int listed = full_status ? dungeon_count : next_instance;
+        std::vector<int> served(&parties_served[0], &parties_served[0] + listed);
+        std::vector<int> time_served(&total_time_served[0], &total_time_served[0] + listed);
+        for (int i = 0; i < listed; i++) {
+            total_parties += served[i];
+            overall_time += time_served[i];
+        }
+        
+        if (full_status || listed <= 2 * summary_rank_count) {
+            for (int i = 0; i < listed; i++) {
+                printRow(i);
+            }
+        } else {
+            for (int id : rankInstances(served, summary_rank_count, true)) {
+                printRow(id);
+            }
+            std::cout << std::setw(10) << "..." << std::endl;
+            std::vector<int> least_busy = rankInstances(served, summary_rank_count, false);
+            for (auto it = least_busy.rbegin(); it != least_busy.rend(); ++it) {
+                printRow(*it);
+            }
         }
         
         std::cout << std::string(60, '-') << std::endl;
         std::cout << std::setw(25) << "TOTAL" 
                   << std::setw(15) << total_parties 
                   << std::setw(15) << overall_time << "s" << std::endl;
+        if (!full_status) {
+            if (listed < dungeon_count) {
+                std::cout << (dungeon_count - listed) << " instance(s) never used" << std::endl;
+            }
+            printDistribution("Parties served per instance", served);
+            printDistribution("Time served per instance (s)", time_served);
+        }
         std::cout << "Remaining players - Tanks: " << tank_queue
                   << ", Healers: " << healer_queue
                   << ", DPS: " << dps_queue << std::endl;
         std::cout << "Total players added by producer: " << total_players_added << std::endl;
         std::cout << "Total parties formed: " << total_parties_formed << std::endl;
+        std::cout << "Instance threads started: " << workers.size() << " of " << dungeon_count << std::endl;
+        if (first_party_formed) {
+            std::cout << "Time to first party: " << std::fixed << std::setprecision(3)
+                      << std::chrono::duration<double, std::milli>(first_party_at - created_at).count()
+                      << " ms" << std::endl;
+        }
     }
 };
 
@@ -284,8 +443,23 @@ int getValidatedIntegerWithRange(const std::string& prompt, int minValue) {
     }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     int n, t, h, d, t1, t2;
+    bool prefault = false;
+    bool full_status = false;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--prefault") {
+            prefault = true;
+        } else if (arg == "--full-status") {
+            full_status = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [--prefault] [--full-status]" << std::endl;
+            return 1;
+        }
+    }
     
     std::cout << "=== MMORPG Dungeon LFG Queue System ===" << std::endl;
     
@@ -308,6 +482,10 @@ int main() {
     std::cout << "System will run for maximum 30 seconds OR until no more parties can be formed." << std::endl;
     
     DungeonManager manager(n, t, h, d);
+    manager.setFullStatus(full_status);
+    if (prefault) {
+        manager.prefaultInstanceState();
+    }
     manager.startInstances(t1, t2);
     
     return 0;
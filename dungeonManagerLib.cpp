@@ -0,0 +1,252 @@
+#include "dungeonManagerLib.h"
+#include "chunkedQueue.h"
+
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include <new>
+
+struct dm_manager {
+    static constexpr int party_roles[3]{1, 1, 3};
+
+    std::mutex mtx;
+    dm_config config;
+
+    using RoleQueue = ChunkedQueue<uint64_t>;
+
+    struct QueuedPlayer {
+        int role;
+        RoleQueue::Handle handle;
+    };
+
+    // Cancelled players are tombstoned in place through their handle, so
+    // matching pops never look up the player table to skip them.
+    RoleQueue::Pool block_pool;
+    RoleQueue role_queues[3]{RoleQueue(block_pool), RoleQueue(block_pool), RoleQueue(block_pool)};
+    std::unordered_map<uint64_t, QueuedPlayer> queued_players;
+
+    std::vector<int32_t> free_instances;
+    std::vector<unsigned char> instance_active;
+
+    uint64_t players_enqueued{0};
+    uint64_t players_cancelled{0};
+    uint64_t parties_formed{0};
+
+    explicit dm_manager(const dm_config& cfg) : config(cfg), instance_active(cfg.instance_count, 0) {
+        free_instances.reserve(cfg.instance_count);
+        for (int32_t i = cfg.instance_count - 1; i >= 0; i--) {
+            free_instances.push_back(i);
+        }
+    }
+
+    bool canFormParty() const {
+        return !free_instances.empty() && role_queues[0].size() >= 1 && role_queues[1].size() >= 1 &&
+               role_queues[2].size() >= 3;
+    }
+
+
+    void cancel(std::unordered_map<uint64_t, QueuedPlayer>::iterator it) {
+        RoleQueue& queue = role_queues[it->second.role];
+        queue.cancel(it->second.handle);
+        queued_players.erase(it);
+        if (queue.shouldCompact()) {
+            try {
+                queue.compact([this](uint64_t player_id, RoleQueue::Handle handle) {
+                    queued_players.find(player_id)->second.handle = handle;
+                });
+            } catch (const std::bad_alloc&) {
+                // Tombstones are still skipped; compaction is retried on the next cancel.
+            }
+        }
+    }
+
+    // Room for a party is reserved before its players leave the queues, so
+    // running out of memory leaves them queued for the next call instead of
+    // forming a party that is never reported.
+    void formParties(std::vector<dm_party>& formed) {
+        while (canFormParty()) {
+            if (formed.size() == formed.capacity()) {
+                try {
+                    formed.reserve(formed.empty() ? 4 : formed.size() * 2);
+                } catch (const std::bad_alloc&) {
+                    return;
+                }
+            }
+            dm_party party;
+            int slot = 0;
+            for (int role = 0; role < 3; role++) {
+                for (int k = 0; k < party_roles[role]; k++) {
+                    party.players[slot++] = role_queues[role].popFront();
+                }
+            }
+            // Erased after all five pops so the table lookups overlap.
+            for (uint64_t player_id : party.players) {
+                queued_players.erase(player_id);
+            }
+            party.instance_id = free_instances.back();
+            free_instances.pop_back();
+            instance_active[party.instance_id] = 1;
+            party.party_id = ++parties_formed;
+            formed.push_back(party);
+        }
+    }
+
+    void dispatch(const std::vector<dm_party>& formed) {
+        if (config.on_party_formed == nullptr) {
+            return;
+        }
+        for (const auto& party : formed) {
+            if (config.executor == nullptr) {
+                config.on_party_formed(config.callback_data, &party);
+                continue;
+            }
+
+            struct PartyTask {
+                dm_party_formed_fn callback;
+                void* callback_data;
+                dm_party party;
+            };
+            PartyTask* task = new (std::nothrow) PartyTask{config.on_party_formed, config.callback_data, party};
+            if (task == nullptr) {
+                // The party is already formed; delivering it late on this
+                // thread beats losing it.
+                config.on_party_formed(config.callback_data, &party);
+                continue;
+            }
+            config.executor(config.executor_data, [](void* data) {
+                PartyTask* pending = static_cast<PartyTask*>(data);
+                pending->callback(pending->callback_data, &pending->party);
+                delete pending;
+            }, task);
+        }
+    }
+};
+
+namespace {
+
+template <typename Operation>
+int runAndDispatch(dm_manager* manager, Operation operation) {
+    std::vector<dm_party> formed_parties;
+    int status;
+    try {
+        {
+            std::lock_guard<std::mutex> lock(manager->mtx);
+            status = operation();
+            if (status == DM_OK) {
+                manager->formParties(formed_parties);
+            }
+        }
+        manager->dispatch(formed_parties);
+    } catch (const std::bad_alloc&) {
+        return DM_ERR_OUT_OF_MEMORY;
+    }
+    return status;
+}
+
+}
+
+extern "C" {
+
+int dm_create(const dm_config* config, dm_manager** out_manager) {
+    if (config == nullptr || out_manager == nullptr) {
+        return DM_ERR_INVALID_ARGUMENT;
+    }
+    if (config->abi_version != DM_ABI_VERSION) {
+        return DM_ERR_ABI_MISMATCH;
+    }
+    if (config->instance_count <= 0) {
+        return DM_ERR_INVALID_ARGUMENT;
+    }
+
+    dm_manager* manager = new (std::nothrow) dm_manager(*config);
+    if (manager == nullptr) {
+        return DM_ERR_OUT_OF_MEMORY;
+    }
+    *out_manager = manager;
+    return DM_OK;
+}
+
+void dm_destroy(dm_manager* manager) {
+    delete manager;
+}
+
+int dm_enqueue(dm_manager* manager, uint64_t player_id, dm_role role) {
+    if (manager == nullptr || role < DM_ROLE_TANK || role > DM_ROLE_DPS) {
+        return DM_ERR_INVALID_ARGUMENT;
+    }
+    return runAndDispatch(manager, [&]() {
+        auto [it, inserted] = manager->queued_players.try_emplace(player_id, dm_manager::QueuedPlayer{role, {}});
+        if (!inserted) {
+            return static_cast<int>(DM_ERR_DUPLICATE_PLAYER);
+        }
+        try {
+            it->second.handle = manager->role_queues[role].push(player_id);
+        } catch (...) {
+            manager->queued_players.erase(it);
+            throw;
+        }
+        manager->players_enqueued++;
+        return static_cast<int>(DM_OK);
+    });
+}
+
+int dm_cancel(dm_manager* manager, uint64_t player_id) {
+    if (manager == nullptr) {
+        return DM_ERR_INVALID_ARGUMENT;
+    }
+
+    std::lock_guard<std::mutex> lock(manager->mtx);
+    auto it = manager->queued_players.find(player_id);
+    if (it == manager->queued_players.end()) {
+        return DM_ERR_UNKNOWN_PLAYER;
+    }
+    manager->cancel(it);
+    manager->players_cancelled++;
+    return DM_OK;
+}
+
+int dm_complete(dm_manager* manager, int32_t instance_id) {
+    if (manager == nullptr || instance_id < 0 || instance_id >= manager->config.instance_count) {
+        return DM_ERR_INVALID_ARGUMENT;
+    }
+    return runAndDispatch(manager, [&]() {
+        if (!manager->instance_active[instance_id]) {
+            return static_cast<int>(DM_ERR_INSTANCE_NOT_ACTIVE);
+        }
+        manager->instance_active[instance_id] = 0;
+        manager->free_instances.push_back(instance_id);
+        return static_cast<int>(DM_OK);
+    });
+}
+
+int dm_get_stats(dm_manager* manager, dm_stats* out_stats) {
+    if (manager == nullptr || out_stats == nullptr) {
+        return DM_ERR_INVALID_ARGUMENT;
+    }
+
+    std::lock_guard<std::mutex> lock(manager->mtx);
+    out_stats->players_enqueued = manager->players_enqueued;
+    out_stats->players_cancelled = manager->players_cancelled;
+    out_stats->parties_formed = manager->parties_formed;
+    for (int role = 0; role < 3; role++) {
+        out_stats->queued[role] = manager->role_queues[role].size();
+    }
+    out_stats->instance_count = manager->config.instance_count;
+    out_stats->active_instances = manager->config.instance_count - static_cast<int32_t>(manager->free_instances.size());
+    return DM_OK;
+}
+
+const char* dm_status_string(int status) {
+    switch (status) {
+        case DM_OK: return "ok";
+        case DM_ERR_INVALID_ARGUMENT: return "invalid argument";
+        case DM_ERR_DUPLICATE_PLAYER: return "player already queued";
+        case DM_ERR_UNKNOWN_PLAYER: return "player not queued";
+        case DM_ERR_INSTANCE_NOT_ACTIVE: return "instance not active";
+        case DM_ERR_OUT_OF_MEMORY: return "out of memory";
+        case DM_ERR_ABI_MISMATCH: return "ABI version mismatch";
+        default: return "unknown status";
+    }
+}
+
+}
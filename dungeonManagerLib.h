@@ -0,0 +1,90 @@
+#ifndef DUNGEON_MANAGER_LIB_H
+#define DUNGEON_MANAGER_LIB_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define DM_API __declspec(dllexport)
+#else
+#define DM_API __attribute__((visibility("default")))
+#endif
+
+#define DM_ABI_VERSION 1
+
+typedef struct dm_manager dm_manager;
+
+typedef enum dm_role {
+    DM_ROLE_TANK = 0,
+    DM_ROLE_HEALER = 1,
+    DM_ROLE_DPS = 2
+} dm_role;
+
+typedef enum dm_status {
+    DM_OK = 0,
+    DM_ERR_INVALID_ARGUMENT = -1,
+    DM_ERR_DUPLICATE_PLAYER = -2,
+    DM_ERR_UNKNOWN_PLAYER = -3,
+    DM_ERR_INSTANCE_NOT_ACTIVE = -4,
+    DM_ERR_OUT_OF_MEMORY = -5,
+    DM_ERR_ABI_MISMATCH = -6
+} dm_status;
+
+/* Players in a party: tank, healer, then three DPS. */
+typedef struct dm_party {
+    uint64_t party_id;
+    int32_t instance_id;
+    uint64_t players[5];
+} dm_party;
+
+typedef struct dm_stats {
+    uint64_t players_enqueued;
+    uint64_t players_cancelled;
+    uint64_t parties_formed;
+    uint64_t queued[3];
+    int32_t active_instances;
+    int32_t instance_count;
+} dm_stats;
+
+/* The party pointer is only valid for the duration of the callback. */
+typedef void (*dm_party_formed_fn)(void* callback_data, const dm_party* party);
+
+typedef void (*dm_task_fn)(void* task_data);
+
+/* Runs task(task_data) exactly once, now or later, on any thread. */
+typedef void (*dm_executor_fn)(void* executor_data, dm_task_fn task, void* task_data);
+
+typedef struct dm_config {
+    uint32_t abi_version;
+    int32_t instance_count;
+    dm_party_formed_fn on_party_formed;
+    void* callback_data;
+    dm_executor_fn executor;
+    void* executor_data;
+} dm_config;
+
+/*
+ * The manager never starts threads. Matching runs inside dm_enqueue and
+ * dm_complete on the calling thread. Party callbacks are delivered after the
+ * internal lock is released, either inline or through the executor if one is
+ * configured, so callbacks may call back into the manager. If a task for the
+ * executor cannot be allocated, that callback runs inline instead.
+ */
+DM_API int dm_create(const dm_config* config, dm_manager** out_manager);
+DM_API void dm_destroy(dm_manager* manager);
+
+DM_API int dm_enqueue(dm_manager* manager, uint64_t player_id, dm_role role);
+DM_API int dm_cancel(dm_manager* manager, uint64_t player_id);
+DM_API int dm_complete(dm_manager* manager, int32_t instance_id);
+
+DM_API int dm_get_stats(dm_manager* manager, dm_stats* out_stats);
+DM_API const char* dm_status_string(int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,151 @@
+#include "dungeonManagerLib.h"
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+
+struct CallbackState {
+    uint64_t parties{0};
+    std::vector<int32_t> finished_instances;
+};
+
+void onPartyFormed(void* callback_data, const dm_party* party) {
+    CallbackState* state = static_cast<CallbackState*>(callback_data);
+    state->parties++;
+    state->finished_instances.push_back(party->instance_id);
+}
+
+void runInline(void*, dm_task_fn task, void* task_data) {
+    task(task_data);
+}
+
+dm_manager* createManager(int instances, CallbackState& state, bool use_executor) {
+    dm_config config{};
+    config.abi_version = DM_ABI_VERSION;
+    config.instance_count = instances;
+    config.on_party_formed = onPartyFormed;
+    config.callback_data = &state;
+    config.executor = use_executor ? runInline : nullptr;
+
+    dm_manager* manager = nullptr;
+    int status = dm_create(&config, &manager);
+    if (status != DM_OK) {
+        std::cerr << "dm_create failed: " << dm_status_string(status) << std::endl;
+        return nullptr;
+    }
+    return manager;
+}
+
+void report(const std::string& name, long long operations, std::chrono::steady_clock::duration elapsed) {
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / operations;
+    std::cout << std::left << std::setw(34) << name << std::right << std::setw(12) << operations
+              << std::fixed << std::setprecision(1) << std::setw(12) << ns << " ns/call" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    long long players = argc > 1 ? std::atoll(argv[1]) : 1000000;
+    long long backlog = argc > 2 ? std::atoll(argv[2]) : 10000000;
+    if (players < 5 || backlog < 5) {
+        std::cerr << "Usage: " << argv[0] << " [players] [backlog players]" << std::endl;
+        return 1;
+    }
+    const dm_role party_pattern[5]{DM_ROLE_TANK, DM_ROLE_HEALER, DM_ROLE_DPS, DM_ROLE_DPS, DM_ROLE_DPS};
+
+    std::cout << "=== C ABI CALL OVERHEAD ===" << std::endl;
+
+    {
+        CallbackState state;
+        dm_manager* manager = createManager(1, state, false);
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < players; i++) {
+            dm_enqueue(manager, static_cast<uint64_t>(i), party_pattern[i % 5]);
+        }
+        report("dm_enqueue (no free instance)", players, std::chrono::steady_clock::now() - start);
+
+        start = std::chrono::steady_clock::now();
+        for (long long i = 5; i < players; i++) {
+            dm_cancel(manager, static_cast<uint64_t>(i));
+        }
+        report("dm_cancel", players - 5, std::chrono::steady_clock::now() - start);
+        dm_destroy(manager);
+    }
+
+    for (int use_executor = 0; use_executor < 2; use_executor++) {
+        CallbackState state;
+        dm_manager* manager = createManager(64, state, use_executor == 1);
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < players; i++) {
+            dm_enqueue(manager, static_cast<uint64_t>(i), party_pattern[i % 5]);
+            for (int32_t instance : state.finished_instances) {
+                dm_complete(manager, instance);
+            }
+            state.finished_instances.clear();
+        }
+        report(use_executor ? "enqueue+match+complete (executor)" : "enqueue+match+complete (inline)",
+               players, std::chrono::steady_clock::now() - start);
+
+        dm_stats stats;
+        dm_get_stats(manager, &stats);
+        if (stats.parties_formed != state.parties || state.parties != static_cast<uint64_t>(players / 5)) {
+            std::cerr << "Unexpected party count: " << stats.parties_formed << " formed, "
+                      << state.parties << " delivered" << std::endl;
+            dm_destroy(manager);
+            return 1;
+        }
+        dm_destroy(manager);
+    }
+
+    // A deep backlog behind one busy instance: 30% of the queued players
+    // cancel at random, then the queue drains one party per completion.
+    {
+        std::cout << "\n=== " << backlog << "-PLAYER BACKLOG, 30% CANCELLED ===" << std::endl;
+        CallbackState state;
+        dm_manager* manager = createManager(1, state, false);
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < backlog; i++) {
+            dm_enqueue(manager, static_cast<uint64_t>(i), party_pattern[i % 5]);
+        }
+        report("dm_enqueue", backlog, std::chrono::steady_clock::now() - start);
+
+        long long cancelled = 0;
+        uint64_t mix = 0x9e3779b97f4a7c15ULL;
+        start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < backlog; i++) {
+            mix ^= mix << 13;
+            mix ^= mix >> 7;
+            mix ^= mix << 17;
+            if (mix % 10 < 3 && dm_cancel(manager, static_cast<uint64_t>(i)) == DM_OK) {
+                cancelled++;
+            }
+        }
+        report("dm_cancel (30% of the backlog)", cancelled, std::chrono::steady_clock::now() - start);
+
+        uint64_t parties_before = state.parties;
+        start = std::chrono::steady_clock::now();
+        while (!state.finished_instances.empty()) {
+            int32_t instance = state.finished_instances.back();
+            state.finished_instances.pop_back();
+            dm_complete(manager, instance);
+        }
+        long long drained = static_cast<long long>(state.parties - parties_before);
+        report("dm_complete draining the backlog", std::max(drained, 1LL), std::chrono::steady_clock::now() - start);
+
+        dm_stats stats;
+        dm_get_stats(manager, &stats);
+        std::cout << "Parties formed: " << stats.parties_formed << " | Left queued: " << stats.queued[0] << " tanks, "
+                  << stats.queued[1] << " healers, " << stats.queued[2] << " DPS" << std::endl;
+        if (stats.queued[0] + stats.queued[1] + stats.queued[2] + 5 * stats.parties_formed + cancelled !=
+            static_cast<uint64_t>(backlog)) {
+            std::cerr << "Players lost in the backlog run" << std::endl;
+            dm_destroy(manager);
+            return 1;
+        }
+        dm_destroy(manager);
+    }
+
+    return 0;
+}
@@ -7,216 +7,1688 @@
 #include <chrono>
 #include <atomic>
 #include <iomanip>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <queue>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <fcntl.h>
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <array>
+#include <cstdlib>
+#include <barrier>
 
-class DungeonManager {
+#include "columnarLog.h"
+#include "ddSketch.h"
+#include "instanceTables.h"
+#include "queueManager.h"
+
+struct SimulationConfig {
+    int instances{10};
+    int tanks{0};
+    int healers{0};
+    int dps{0};
+    int min_time{1};
+    int max_time{5};
+    int interval_ms{3000};
+    int runtime_seconds{30};
+    int min_batch{1};
+    int max_batch{3};
+    double role_weights[3]{1.0, 1.0, 1.0};
+    int regions{1};
+    int match_window_ms{0};
+    int match_budget_us{200};
+    int match_max_hold_seconds{30};
+    int tick_ms{0};
+    uint64_t seed{1};
+    std::shared_ptr<const ScenarioSchedule> scenario;
+};
+
+struct SimulationResult {
+    long long parties{0};
+    double utilization{0.0};
+    double mean_wait{0.0};
+    double p99_wait{0.0};
+    long long leftover[3]{0, 0, 0};
+    double mean_spread{0.0};
+    double p95_spread{0.0};
+    double matcher_us{0.0};
+    long long match_rounds{0};
+    double elapsed_ms{0.0};
+};
+
+class VirtualSimulation {
 private:
-    std::mutex mtx;
-    std::condition_variable cv;
+    static constexpr int party_roles[3]{1, 1, 3};
+    static constexpr int party_size = 5;
     
-    int tank_queue;
-    int healer_queue;
-    int dps_queue;
+    struct QueuedPlayer {
+        double arrival;
+        float mmr;
+    };
     
-    int dungeon_count;
-    std::vector<bool> dungeon_active;
-    std::vector<int> parties_served;
-    std::vector<int> total_time_served;
+    SimulationConfig config;
+    BulkRandom gen;
+    std::vector<std::deque<QueuedPlayer>> role_queues[3];
+    std::priority_queue<double, std::vector<double>, std::greater<double>> completions;
+    int free_instances;
+    int capacity;
+    int offline{0};
+    double capacity_seconds{0.0};
+    double busy_time{0.0};
+    std::vector<double> waits;
+    std::vector<double> spreads;
+    SimulationResult result;
+    ColumnarEventLog* event_log{nullptr};
+    int64_t log_epoch_us{0};
+    bool sketching{false};
+    DDSketch wait_sketches[3];
+    DDSketch duration_sketch;
     
-    std::random_device rd;
-    std::mt19937 gen;
+    // A scenario capacity above --instances is clamped, as in the real-time run.
+    int usableInstances() const {
+        return std::clamp(capacity - offline, 0, config.instances);
+    }
     
-    std::atomic<int> total_parties_formed{0};
-    std::atomic<int> total_players_added{0};
-    bool shutdown{false};
-
-public:
-    DungeonManager(int n, int t, int h, int d) 
-        : dungeon_count(n), tank_queue(t), healer_queue(h), dps_queue(d), gen(rd()) {
-        dungeon_active.resize(n, false);
-        parties_served.resize(n, 0);
-        total_time_served.resize(n, 0);
+    void logMatch(double now, int role, int region, double wait) {
+        event_log->append(log_epoch_us + static_cast<int64_t>(now * 1e6), COLUMNAR_MATCHED, role, region,
+                          static_cast<float>(wait * 1000.0));
     }
-
-    bool canFormParty() {
-        return tank_queue >= 1 && healer_queue >= 1 && dps_queue >= 3;
+    
+    void startParty(double now, const QueuedPlayer* members, int region) {
+        float lowest = members[0].mmr;
+        float highest = members[0].mmr;
+        for (int i = 0; i < party_size; i++) {
+            waits.push_back(now - members[i].arrival);
+            if (event_log != nullptr) {
+                logMatch(now, i == 0 ? 0 : i == 1 ? 1 : 2, region, now - members[i].arrival);
+            }
+            if (sketching) {
+                wait_sketches[i == 0 ? 0 : i == 1 ? 1 : 2].add(now - members[i].arrival);
+            }
+            lowest = std::min(lowest, members[i].mmr);
+            highest = std::max(highest, members[i].mmr);
+        }
+        spreads.push_back(highest - lowest);
+        
+        int dungeon_time = gen.between(config.min_time, config.max_time);
+        if (sketching) {
+            duration_sketch.add(dungeon_time);
+        }
+        completions.push(now + dungeon_time);
+        busy_time += std::min<double>(dungeon_time, config.runtime_seconds - now);
+        free_instances--;
+        result.parties++;
     }
-
-    void formParty() {
-        tank_queue -= 1;
-        healer_queue -= 1;
-        dps_queue -= 3;
-        total_parties_formed++;
+    
+    bool canFormParty(int region) const {
+        return role_queues[0][region].size() >= 1 && role_queues[1][region].size() >= 1 &&
+               role_queues[2][region].size() >= 3;
     }
-
-    void addPlayersToQueue(int tanks, int healers, int dps) {
-        tank_queue += tanks;
-        healer_queue += healers;
-        dps_queue += dps;
-        total_players_added += (tanks + healers + dps);
+    
+    void tryMatch(double now) {
+        for (int region = 0; region < config.regions; region++) {
+            while (free_instances > 0 && canFormParty(region)) {
+                QueuedPlayer members[party_size];
+                int slot = 0;
+                for (int role = 0; role < 3; role++) {
+                    for (int k = 0; k < party_roles[role]; k++) {
+                        members[slot++] = role_queues[role][region].front();
+                        role_queues[role][region].pop_front();
+                    }
+                }
+                startParty(now, members, region);
+            }
+        }
+    }
+    
+    static float partySpread(const std::vector<QueuedPlayer>* chosen, int party) {
+        float lowest = chosen[0][party].mmr;
+        float highest = lowest;
+        for (int role = 1; role < 3; role++) {
+            for (int k = 0; k < party_roles[role]; k++) {
+                float mmr = chosen[role][party * party_roles[role] + k].mmr;
+                lowest = std::min(lowest, mmr);
+                highest = std::max(highest, mmr);
+            }
+        }
+        return highest - lowest;
+    }
+    
+    void selectNearest(std::deque<QueuedPlayer>& queue, double now, std::vector<float> targets,
+                       std::vector<QueuedPlayer>& chosen) {
+        size_t overdue = 0;
+        while (overdue < queue.size() && overdue < targets.size() &&
+               now - queue[overdue].arrival >= config.match_max_hold_seconds) {
+            auto nearest = std::min_element(targets.begin(), targets.end(), [&](float a, float b) {
+                return std::fabs(a - queue[overdue].mmr) < std::fabs(b - queue[overdue].mmr);
+            });
+            targets.erase(nearest);
+            chosen.push_back(queue[overdue++]);
+        }
         
-        std::cout << "Producer: Added " << tanks << " tanks, " << healers 
-                  << " healers, " << dps << " DPS to queue." << std::endl;
+        std::vector<QueuedPlayer> candidates(queue.begin() + overdue, queue.end());
+        std::sort(candidates.begin(), candidates.end(),
+                  [](const QueuedPlayer& a, const QueuedPlayer& b) { return a.mmr < b.mmr; });
         
-        cv.notify_all();
+        std::vector<bool> taken(candidates.size(), false);
+        size_t next = 0;
+        for (size_t i = 0; i < targets.size(); i++) {
+            size_t spare = candidates.size() - next - (targets.size() - i);
+            while (spare > 0 && std::fabs(candidates[next + 1].mmr - targets[i]) <= std::fabs(candidates[next].mmr - targets[i])) {
+                next++;
+                spare--;
+            }
+            chosen.push_back(candidates[next]);
+            taken[next++] = true;
+        }
+        
+        queue.clear();
+        for (size_t i = 0; i < candidates.size(); i++) {
+            if (!taken[i]) {
+                queue.push_back(candidates[i]);
+            }
+        }
+        std::sort(queue.begin(), queue.end(),
+                  [](const QueuedPlayer& a, const QueuedPlayer& b) { return a.arrival < b.arrival; });
     }
-
-    void displayStatus() {
-        std::lock_guard<std::mutex> lock(mtx);
-        std::cout << "\n=== Current Instance Status ===" << std::endl;
-        for (int i = 0; i < dungeon_count; i++) {
-            std::cout << "Instance " << (i + 1) << ": " 
-                      << (dungeon_active[i] ? "ACTIVE" : "EMPTY") 
-                      << " | Parties served: " << parties_served[i] 
-                      << " | Total time: " << total_time_served[i] << "s" << std::endl;
+    
+    void matchWindow(double now) {
+        auto wall_start = std::chrono::steady_clock::now();
+        auto deadline = wall_start + std::chrono::microseconds(config.match_budget_us);
+        result.match_rounds++;
+        
+        for (int region = 0; region < config.regions && free_instances > 0; region++) {
+            int parties = std::min({free_instances,
+                                    static_cast<int>(role_queues[0][region].size()),
+                                    static_cast<int>(role_queues[1][region].size()),
+                                    static_cast<int>(role_queues[2][region].size() / 3)});
+            if (parties <= 0) {
+                continue;
+            }
+            
+            int anchor = 0;
+            for (int role = 1; role < 3; role++) {
+                if (role_queues[role][region].size() * party_roles[anchor] <
+                    role_queues[anchor][region].size() * party_roles[role]) {
+                    anchor = role;
+                }
+            }
+            
+            std::vector<QueuedPlayer> chosen[3];
+            auto& anchor_queue = role_queues[anchor][region];
+            int anchor_needed = parties * party_roles[anchor];
+            chosen[anchor].assign(anchor_queue.begin(), anchor_queue.begin() + anchor_needed);
+            anchor_queue.erase(anchor_queue.begin(), anchor_queue.begin() + anchor_needed);
+            std::sort(chosen[anchor].begin(), chosen[anchor].end(),
+                      [](const QueuedPlayer& a, const QueuedPlayer& b) { return a.mmr < b.mmr; });
+            
+            std::vector<float> party_centers(parties);
+            for (int p = 0; p < parties; p++) {
+                float total = 0.0f;
+                for (int k = 0; k < party_roles[anchor]; k++) {
+                    total += chosen[anchor][p * party_roles[anchor] + k].mmr;
+                }
+                party_centers[p] = total / party_roles[anchor];
+            }
+            
+            for (int role = 0; role < 3; role++) {
+                if (role == anchor) {
+                    continue;
+                }
+                std::vector<float> targets;
+                for (int p = 0; p < parties; p++) {
+                    targets.insert(targets.end(), party_roles[role], party_centers[p]);
+                }
+                selectNearest(role_queues[role][region], now, targets, chosen[role]);
+                std::sort(chosen[role].begin(), chosen[role].end(),
+                          [](const QueuedPlayer& a, const QueuedPlayer& b) { return a.mmr < b.mmr; });
+            }
+            
+            for (long long iteration = 0; parties > 1; iteration++) {
+                if ((iteration & 63) == 0 && std::chrono::steady_clock::now() >= deadline) {
+                    break;
+                }
+                int a = static_cast<int>(gen.below(parties));
+                int b = static_cast<int>(gen.below(parties));
+                int role = static_cast<int>(gen.below(3));
+                if (a == b) {
+                    continue;
+                }
+                size_t slot_a = a * party_roles[role] + gen() % party_roles[role];
+                size_t slot_b = b * party_roles[role] + gen() % party_roles[role];
+                float before = partySpread(chosen, a) + partySpread(chosen, b);
+                std::swap(chosen[role][slot_a], chosen[role][slot_b]);
+                if (partySpread(chosen, a) + partySpread(chosen, b) > before) {
+                    std::swap(chosen[role][slot_a], chosen[role][slot_b]);
+                }
+            }
+            
+            for (int p = 0; p < parties; p++) {
+                QueuedPlayer members[party_size];
+                int slot = 0;
+                for (int role = 0; role < 3; role++) {
+                    for (int k = 0; k < party_roles[role]; k++) {
+                        members[slot++] = chosen[role][p * party_roles[role] + k];
+                    }
+                }
+                startParty(now, members, region);
+            }
         }
-        std::cout << "Players in queue - Tanks: " << tank_queue
-                  << ", Healers: " << healer_queue
-                  << ", DPS: " << dps_queue << std::endl;
-        std::cout << "Total parties formed: " << total_parties_formed << std::endl;
-        std::cout << "Total players added: " << total_players_added << std::endl;
-        std::cout << "================================\n" << std::endl;
+        
+        result.matcher_us += std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - wall_start).count();
     }
 
-    void dungeonInstance(int instance_id, int t1, int t2) {
-        std::uniform_int_distribution<> time_dist(t1, t2);
+    SimulationResult finish(std::chrono::steady_clock::time_point wall_start) {
+        result.utilization = capacity_seconds > 0 ? busy_time / capacity_seconds : 0.0;
+        if (!waits.empty()) {
+            double total = 0.0;
+            for (double wait : waits) {
+                total += wait;
+            }
+            result.mean_wait = total / waits.size();
+            size_t rank = static_cast<size_t>(std::ceil(0.99 * waits.size())) - 1;
+            std::nth_element(waits.begin(), waits.begin() + rank, waits.end());
+            result.p99_wait = waits[rank];
+        }
+        if (!spreads.empty()) {
+            double total = 0.0;
+            for (double spread : spreads) {
+                total += spread;
+            }
+            result.mean_spread = total / spreads.size();
+            size_t rank = static_cast<size_t>(std::ceil(0.95 * spreads.size())) - 1;
+            std::nth_element(spreads.begin(), spreads.begin() + rank, spreads.end());
+            result.p95_spread = spreads[rank];
+        }
+        result.elapsed_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - wall_start).count();
+        return result;
+    }
+    
+    // Fixed-timestep variant of run() for servers that match on a tick. A tick
+    // covers (start, end]: everything arriving or completing inside it is
+    // applied first and one greedy matching pass runs at its end. Queues are
+    // flat arrays of arrival times consumed from a head index, and completions
+    // are counted per tick in a timing wheel, so a tick costs one sweep over
+    // the regions no matter how many events it batched.
+    SimulationResult runTicks() {
+        struct FlatQueue {
+            std::vector<double> arrivals;
+            size_t head{0};
+            
+            size_t size() const {
+                return arrivals.size() - head;
+            }
+            
+            void compact() {
+                if (head > 4096 && head * 2 > arrivals.size()) {
+                    arrivals.erase(arrivals.begin(), arrivals.begin() + head);
+                    head = 0;
+                }
+            }
+        };
         
-        while (true) {
-            std::unique_lock<std::mutex> lock(mtx);
+        auto wall_start = std::chrono::steady_clock::now();
+        
+        std::vector<FlatQueue> queues[3];
+        for (auto& role_queues_by_region : queues) {
+            role_queues_by_region.resize(config.regions);
+        }
+        int initial[3]{config.tanks, config.healers, config.dps};
+        for (int role = 0; role < 3; role++) {
+            for (int i = 0; i < initial[role]; i++) {
+                queues[role][gen.below(config.regions)].arrivals.push_back(0.0);
+            }
+        }
+        
+        // Tick boundaries and dungeon times are whole milliseconds, so the tick
+        // a completion falls into is computed exactly.
+        long long tick_ms = config.tick_ms;
+        long long horizon_ms = config.runtime_seconds * 1000LL;
+        long long tick_count = (horizon_ms + tick_ms - 1) / tick_ms;
+        std::vector<int> wheel((config.max_time * 1000LL + tick_ms - 1) / tick_ms + 2, 0);
+        std::vector<int> durations;
+        
+        const ScenarioSchedule* scenario = config.scenario.get();
+        long long next_batch_ms = 0;
+        double cumulative = 0.0;
+        size_t segment = 0;
+        size_t next_event = 0;
+        double next_arrival = scenario != nullptr ? scenario->nextArrival(cumulative, segment, gen.exponential())
+                                                  : config.runtime_seconds + 1.0;
+        double last_time = 0.0;
+        
+        for (long long tick = 0; tick < tick_count; tick++) {
+            long long end_ms = std::min(horizon_ms, (tick + 1) * tick_ms);
+            double now = end_ms / 1000.0;
+            bool last_tick = end_ms == horizon_ms;
             
-            cv.wait(lock, [this]() { 
-                return canFormParty() || shutdown; 
-            });
+            int& completed = wheel[tick % wheel.size()];
+            free_instances += completed;
+            completed = 0;
             
-            if (shutdown && !canFormParty()) {
-                break;
+            while (scenario != nullptr && next_event < scenario->events.size() &&
+                   scenario->events[next_event].time <= now && !(last_tick && scenario->events[next_event].time >= now)) {
+                const ScenarioEvent& event = scenario->events[next_event++];
+                if (event.kind == ScenarioEvent::Burst) {
+                    for (int i = 0; i < event.value; i++) {
+                        int role = scenario->roleAt(event.time, gen.unit());
+                        queues[role][gen.below(config.regions)].arrivals.push_back(event.time);
+                    }
+                    continue;
+                }
+                capacity_seconds += usableInstances() * (event.time - last_time);
+                last_time = event.time;
+                int before = usableInstances();
+                if (event.kind == ScenarioEvent::Capacity) {
+                    capacity = event.value;
+                } else {
+                    offline += event.value;
+                }
+                free_instances += usableInstances() - before;
             }
             
-            if (canFormParty()) {
-                formParty();
-                dungeon_active[instance_id] = true;
-                parties_served[instance_id]++;
-                
-                std::cout << "Instance " << (instance_id + 1) 
-                          << ": Party formed! Starting dungeon..." << std::endl;
-                
-                lock.unlock();
-                
-                int dungeon_time = time_dist(gen);
-                std::this_thread::sleep_for(std::chrono::seconds(dungeon_time));
-                
-                lock.lock();
-                total_time_served[instance_id] += dungeon_time;
-                dungeon_active[instance_id] = false;
-                
-                std::cout << "Instance " << (instance_id + 1) 
-                          << ": Dungeon completed in " << dungeon_time << " seconds!" << std::endl;
-                
-                cv.notify_all();
-            }
-        }
-    }
-
-    void playerProducer(int interval_ms, int max_runtime_seconds) {
-        std::uniform_int_distribution<> role_dist(0, 2);
-        std::uniform_int_distribution<> count_dist(1, 3);
-        
-        auto start_time = std::chrono::steady_clock::now();
+            if (scenario != nullptr) {
+                while (next_arrival <= now && !(last_tick && next_arrival >= now)) {
+                    int role = scenario->pickRole(segment, gen.unit());
+                    queues[role][gen.below(config.regions)].arrivals.push_back(next_arrival);
+                    next_arrival = scenario->nextArrival(cumulative, segment, gen.exponential());
+                }
+            } else {
+                while (next_batch_ms <= end_ms && next_batch_ms < horizon_ms) {
+                    int players = gen.between(config.min_batch, config.max_batch);
+                    for (int i = 0; i < players; i++) {
+                        int role = gen.weighted(config.role_weights);
+                        queues[role][gen.below(config.regions)].arrivals.push_back(next_batch_ms / 1000.0);
+                    }
+                    next_batch_ms += config.interval_ms;
+                }
+            }
+            
+            if (last_tick) {
+                break;
+            }
+            result.match_rounds++;
+            for (int region = 0; region < config.regions && free_instances > 0; region++) {
+                int parties = static_cast<int>(std::min({static_cast<size_t>(free_instances), queues[0][region].size(),
+                                                         queues[1][region].size(), queues[2][region].size() / 3}));
+                if (parties <= 0) {
+                    continue;
+                }
+                for (int role = 0; role < 3; role++) {
+                    FlatQueue& queue = queues[role][region];
+                    const double* arrivals = queue.arrivals.data() + queue.head;
+                    size_t taken = static_cast<size_t>(parties) * party_roles[role];
+                    for (size_t i = 0; i < taken; i++) {
+                        waits.push_back(now - arrivals[i]);
+                        if (event_log != nullptr) {
+                            logMatch(now, role, region, now - arrivals[i]);
+                        }
+                        if (sketching) {
+                            wait_sketches[role].add(now - arrivals[i]);
+                        }
+                    }
+                    queue.head += taken;
+                    queue.compact();
+                }
+                durations.resize(parties);
+                gen.fillBetween(durations.data(), durations.size(), config.min_time, config.max_time);
+                for (int p = 0; p < parties; p++) {
+                    int dungeon_time = durations[p];
+                    if (sketching) {
+                        duration_sketch.add(dungeon_time);
+                    }
+                    long long done_ms = end_ms + dungeon_time * 1000LL;
+                    long long done_tick = std::max(tick + 1, (done_ms + tick_ms - 1) / tick_ms - 1);
+                    wheel[done_tick % wheel.size()]++;
+                    busy_time += std::min<double>(dungeon_time, config.runtime_seconds - now);
+                }
+                free_instances -= parties;
+                result.parties += parties;
+            }
+        }
+        
+        for (int role = 0; role < 3; role++) {
+            for (const auto& queue : queues[role]) {
+                result.leftover[role] += static_cast<long long>(queue.size());
+            }
+        }
+        capacity_seconds += usableInstances() * (config.runtime_seconds - last_time);
+        return finish(wall_start);
+    }
+
+public:
+    explicit VirtualSimulation(const SimulationConfig& cfg)
+        : config(cfg), gen(cfg.seed), free_instances(cfg.instances), capacity(cfg.instances) {
+        for (auto& queues : role_queues) {
+            queues.resize(std::max(1, config.regions));
+        }
+        config.regions = std::max(1, config.regions);
+        if (config.scenario) {
+            config.runtime_seconds = static_cast<int>(std::ceil(config.scenario->duration));
+        }
+    }
+    
+    // Records every matched player, with simulated time 0 mapped to epoch_us.
+    void setEventLog(ColumnarEventLog* log, int64_t epoch_us) {
+        event_log = log;
+        log_epoch_us = epoch_us;
+    }
+    
+    // Also feeds per-role wait and dungeon duration sketches; off by default
+    // because replicated reports only need the exact waits.
+    void enableSketches() {
+        sketching = true;
+    }
+    
+    NamedSketches sketches() const {
+        return {{"wait/tank", wait_sketches[0]}, {"wait/healer", wait_sketches[1]},
+                {"wait/dps", wait_sketches[2]}, {"duration", duration_sketch}};
+    }
+    
+    SimulationResult run() {
+        if (config.tick_ms > 0) {
+            return runTicks();
+        }
+        auto wall_start = std::chrono::steady_clock::now();
+        auto mmr = [this]() { return static_cast<float>(gen.normal(1500.0, 300.0)); };
+        
+        int initial[3]{config.tanks, config.healers, config.dps};
+        for (int role = 0; role < 3; role++) {
+            for (int i = 0; i < initial[role]; i++) {
+                role_queues[role][gen.below(config.regions)].push_back({0.0, mmr()});
+            }
+        }
+        
+        double horizon = config.runtime_seconds;
+        double interval = config.interval_ms / 1000.0;
+        double window = config.match_window_ms / 1000.0;
+        double next_arrival = 0.0;
+        double next_window = window > 0 ? 0.0 : horizon + 1.0;
+        
+        const ScenarioSchedule* scenario = config.scenario.get();
+        double cumulative = 0.0;
+        size_t segment = 0;
+        size_t next_event = 0;
+        if (scenario != nullptr) {
+            next_arrival = scenario->nextArrival(cumulative, segment, gen.exponential());
+        }
+        double last_time = 0.0;
         
         while (true) {
-            auto current_time = std::chrono::steady_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
-            
-            if (elapsed >= max_runtime_seconds) {
-                std::cout << "Reached maximum runtime. Stopping producer." << std::endl;
+            double next_completion = completions.empty() ? horizon + 1.0 : completions.top();
+            double now = std::min({next_arrival, next_completion, next_window});
+            if (scenario != nullptr && next_event < scenario->events.size()) {
+                now = std::min(now, scenario->events[next_event].time);
+            }
+            if (now >= horizon) {
                 break;
             }
+            capacity_seconds += usableInstances() * (now - last_time);
+            last_time = now;
             
-            int tanks_to_add = 0;
-            int healers_to_add = 0;
-            int dps_to_add = 0;
+            while (!completions.empty() && completions.top() <= now) {
+                completions.pop();
+                free_instances++;
+            }
             
-            int players_to_add = count_dist(gen);
-            for (int i = 0; i < players_to_add; i++) {
-                int role = role_dist(gen);
-                switch (role) {
-                    case 0: tanks_to_add++; break;
-                    case 1: healers_to_add++; break;
-                    case 2: dps_to_add++; break;
+            while (scenario != nullptr && next_event < scenario->events.size() &&
+                   scenario->events[next_event].time <= now) {
+                const ScenarioEvent& event = scenario->events[next_event++];
+                if (event.kind == ScenarioEvent::Burst) {
+                    for (int i = 0; i < event.value; i++) {
+                        int role = scenario->roleAt(now, gen.unit());
+                        role_queues[role][gen.below(config.regions)].push_back({now, mmr()});
+                    }
+                } else {
+                    int before = usableInstances();
+                    if (event.kind == ScenarioEvent::Capacity) {
+                        capacity = event.value;
+                    } else {
+                        offline += event.value;
+                    }
+                    // Busy instances finish their dungeon; free_instances may go
+                    // negative until enough of them complete.
+                    free_instances += usableInstances() - before;
                 }
             }
             
-            {
-                std::lock_guard<std::mutex> lock(mtx);
-                addPlayersToQueue(tanks_to_add, healers_to_add, dps_to_add);
+            if (next_arrival <= now) {
+                if (scenario != nullptr) {
+                    int role = scenario->pickRole(segment, gen.unit());
+                    role_queues[role][gen.below(config.regions)].push_back({now, mmr()});
+                    next_arrival = scenario->nextArrival(cumulative, segment, gen.exponential());
+                } else {
+                    int players = gen.between(config.min_batch, config.max_batch);
+                    for (int i = 0; i < players; i++) {
+                        int role = gen.weighted(config.role_weights);
+                        role_queues[role][gen.below(config.regions)].push_back({now, mmr()});
+                    }
+                    next_arrival += interval;
+                }
             }
             
-            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+            if (window <= 0) {
+                tryMatch(now);
+            } else if (next_window <= now) {
+                matchWindow(now);
+                next_window += window;
+            }
         }
+        
+        for (int role = 0; role < 3; role++) {
+            for (const auto& queue : role_queues[role]) {
+                result.leftover[role] += static_cast<long long>(queue.size());
+            }
+        }
+        capacity_seconds += usableInstances() * (horizon - last_time);
+        return finish(wall_start);
     }
+    
+    const std::vector<double>& playerWaits() const {
+        return waits;
+    }
+};
+
+// Conservative parallel version of VirtualSimulation's greedy matcher. Regions
+// are dealt round-robin to partitions; each partition owns the queue shards of
+// its regions, a share of the instance pool and its own completion heap, and
+// runs on its own thread. Virtual time advances in windows of one lookahead
+// separated by a barrier. Arrivals are exogenous, so every partition samples
+// its share of the arrival stream one window ahead and posts players bound for
+// other partitions into double-buffered mailboxes; nothing can arrive inside
+// the window its receiver is processing. At each barrier, free instances move
+// from idle partitions to partitions with parties waiting, so the pool acts as
+// shared with at most one window of delay.
+class ParallelSimulation {
+public:
+    struct Stats {
+        SimulationResult result;
+        int partitions{0};
+        long long windows{0};
+        long long events{0};
+        long long remote_players{0};
+        long long migrated_instances{0};
+        NamedSketches shard_sketches;
+        DDSketch wait_sketch;
+        DDSketch duration_sketch;
+        double merge_us{0.0};
+    };
 
-    void startInstances(int t1, int t2, int producer_interval_ms = 3000, int max_runtime_seconds = 30) {
-        std::vector<std::thread> instances;
+private:
+    static constexpr int party_roles[3]{1, 1, 3};
+    
+    struct Arrival {
+        double time;
+        int region;
+        int role;
+    };
+    
+    struct alignas(64) Partition {
+        int index{0};
+        int region_count{0};
+        int region_offset{0};
+        BulkRandom gen;
         
-        for (int i = 0; i < dungeon_count; i++) {
-            instances.emplace_back(&DungeonManager::dungeonInstance, this, i, t1, t2);
+        std::vector<std::deque<double>> role_queues[3];
+        std::priority_queue<double, std::vector<double>, std::greater<double>> completions;
+        std::vector<std::vector<Arrival>> outbox[2];
+        std::vector<Arrival> inbox;
+        
+        int free_instances{0};
+        int capacity{0};
+        int offline{0};
+        double capacity_seconds{0.0};
+        double busy_time{0.0};
+        double last_time{0.0};
+        std::vector<double> waits;
+        DDSketch wait_sketch;
+        DDSketch duration_sketch;
+        long long parties{0};
+        long long events{0};
+        long long remote_players{0};
+        int ready_parties{0};
+        
+        long long next_batch{0};
+        double next_arrival{0.0};
+        double cumulative{0.0};
+        size_t segment{0};
+        size_t next_burst{0};
+        size_t next_event{0};
+    };
+    
+    SimulationConfig config;
+    int partition_count;
+    double lookahead;
+    double horizon;
+    std::vector<Partition> partitions;
+    long long migrated_instances{0};
+    
+    // Splits a pool-wide instance count between partitions in proportion to
+    // the regions they own; the shares always add up to value.
+    int shareOf(const Partition& part, int value) const {
+        long long start = static_cast<long long>(value) * part.region_offset / config.regions;
+        long long end = static_cast<long long>(value) * (part.region_offset + part.region_count) / config.regions;
+        return static_cast<int>(end - start);
+    }
+    
+    // A scenario capacity above --instances is clamped, as in the real-time run.
+    int usableInstances(const Partition& part) const {
+        return std::clamp(part.capacity - part.offline, 0, shareOf(part, config.instances));
+    }
+    
+    void post(Partition& part, int buffer, double time, int role) {
+        int region = static_cast<int>(part.gen.below(config.regions));
+        int target = region % partition_count;
+        part.outbox[buffer][target].push_back({time, region / partition_count, role});
+        if (target != part.index) {
+            part.remote_players++;
+        }
+    }
+    
+    // Samples this partition's share of arrivals in [from, to): every
+    // partition_count-th fixed batch, or a Poisson stream thinned to
+    // 1/partition_count of the scenario rate plus a share of each burst.
+    void generate(Partition& part, int buffer, double to) {
+        const ScenarioSchedule* scenario = config.scenario.get();
+        if (scenario == nullptr) {
+            double interval = config.interval_ms / 1000.0;
+            for (double time = part.next_batch * interval; time < to; time = part.next_batch * interval) {
+                int players = part.gen.between(config.min_batch, config.max_batch);
+                for (int i = 0; i < players; i++) {
+                    post(part, buffer, time, part.gen.weighted(config.role_weights));
+                }
+                part.next_batch += partition_count;
+            }
+            return;
         }
         
-        std::thread producer_thread(&DungeonManager::playerProducer, this, producer_interval_ms, max_runtime_seconds);
+        while (part.next_arrival < to) {
+            post(part, buffer, part.next_arrival, scenario->pickRole(part.segment, part.gen.unit()));
+            part.next_arrival = scenario->nextArrival(part.cumulative, part.segment,
+                                                      part.gen.exponential() * partition_count);
+        }
+        while (part.next_burst < scenario->events.size() && scenario->events[part.next_burst].time < to) {
+            const ScenarioEvent& event = scenario->events[part.next_burst++];
+            if (event.kind != ScenarioEvent::Burst) {
+                continue;
+            }
+            int players = event.value / partition_count + (part.index < event.value % partition_count ? 1 : 0);
+            for (int i = 0; i < players; i++) {
+                post(part, buffer, event.time, scenario->roleAt(event.time, part.gen.unit()));
+            }
+        }
+    }
+    
+    void tryMatch(Partition& part, double now) {
+        for (int region = 0; region < part.region_count; region++) {
+            auto& tanks = part.role_queues[0][region];
+            auto& healers = part.role_queues[1][region];
+            auto& dps = part.role_queues[2][region];
+            while (part.free_instances > 0 && !tanks.empty() && !healers.empty() && dps.size() >= 3) {
+                for (int role = 0; role < 3; role++) {
+                    for (int k = 0; k < party_roles[role]; k++) {
+                        part.waits.push_back(now - part.role_queues[role][region].front());
+                        part.wait_sketch.add(part.waits.back());
+                        part.role_queues[role][region].pop_front();
+                    }
+                }
+                int dungeon_time = part.gen.between(config.min_time, config.max_time);
+                part.duration_sketch.add(dungeon_time);
+                part.completions.push(now + dungeon_time);
+                part.busy_time += std::min<double>(dungeon_time, horizon - now);
+                part.free_instances--;
+                part.parties++;
+            }
+        }
+    }
+    
+    // Computed the same way everywhere so generation and processing agree on
+    // which window a boundary arrival belongs to.
+    double windowEnd(long long window) const {
+        return std::min(horizon, (window + 1) * lookahead);
+    }
+    
+    void processWindow(Partition& part, long long window) {
+        double end = windowEnd(window);
+        const ScenarioSchedule* scenario = config.scenario.get();
+        int buffer = static_cast<int>(window & 1);
+        part.inbox.clear();
+        for (auto& source : partitions) {
+            const auto& mail = source.outbox[buffer][part.index];
+            part.inbox.insert(part.inbox.end(), mail.begin(), mail.end());
+        }
+        std::sort(part.inbox.begin(), part.inbox.end(),
+                  [](const Arrival& a, const Arrival& b) { return a.time < b.time; });
         
-        auto start_time = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - start_time < std::chrono::seconds(max_runtime_seconds)) {
-            displayStatus();
-            std::this_thread::sleep_for(std::chrono::seconds(2));
+        // Receivers finished reading this buffer before the last barrier.
+        for (auto& mail : part.outbox[buffer ^ 1]) {
+            mail.clear();
         }
+        generate(part, buffer ^ 1, windowEnd(window + 1));
         
-        {
-            std::lock_guard<std::mutex> lock(mtx);
-            shutdown = true;
-            cv.notify_all();
+        tryMatch(part, window * lookahead);
+        size_t next = 0;
+        while (true) {
+            double now = end;
+            if (next < part.inbox.size()) {
+                now = std::min(now, part.inbox[next].time);
+            }
+            if (!part.completions.empty()) {
+                now = std::min(now, part.completions.top());
+            }
+            if (scenario != nullptr && part.next_event < scenario->events.size()) {
+                now = std::min(now, scenario->events[part.next_event].time);
+            }
+            if (now >= end) {
+                break;
+            }
+            part.capacity_seconds += usableInstances(part) * (now - part.last_time);
+            part.last_time = now;
+            
+            while (!part.completions.empty() && part.completions.top() <= now) {
+                part.completions.pop();
+                part.free_instances++;
+                part.events++;
+            }
+            while (scenario != nullptr && part.next_event < scenario->events.size() &&
+                   scenario->events[part.next_event].time <= now) {
+                const ScenarioEvent& event = scenario->events[part.next_event++];
+                if (event.kind == ScenarioEvent::Burst) {
+                    continue;
+                }
+                int before = usableInstances(part);
+                if (event.kind == ScenarioEvent::Capacity) {
+                    part.capacity = shareOf(part, event.value);
+                } else {
+                    part.offline += shareOf(part, event.value);
+                }
+                part.free_instances += usableInstances(part) - before;
+                part.events++;
+            }
+            while (next < part.inbox.size() && part.inbox[next].time <= now) {
+                const Arrival& arrival = part.inbox[next++];
+                part.role_queues[arrival.role][arrival.region].push_back(arrival.time);
+                part.events++;
+            }
+            tryMatch(part, now);
         }
         
-        producer_thread.join();
+        part.ready_parties = 0;
+        if (part.free_instances <= 0) {
+            for (int region = 0; region < part.region_count; region++) {
+                part.ready_parties += static_cast<int>(std::min({part.role_queues[0][region].size(),
+                                                                 part.role_queues[1][region].size(),
+                                                                 part.role_queues[2][region].size() / 3}));
+            }
+        }
+    }
+    
+    // Runs once per barrier phase on a single thread while every partition waits.
+    void migrateInstances() noexcept {
+        long long spare = 0;
+        long long wanted = 0;
+        for (const auto& part : partitions) {
+            spare += std::max(0, part.free_instances);
+            wanted += part.ready_parties - std::min(0, part.free_instances);
+        }
+        long long moving = std::min(spare, wanted);
+        long long taken = moving;
+        long long given = moving;
+        for (auto& part : partitions) {
+            if (part.free_instances > 0 && taken > 0) {
+                int count = static_cast<int>(std::min<long long>(taken, part.free_instances));
+                part.free_instances -= count;
+                taken -= count;
+            } else if (part.free_instances <= 0 && given > 0) {
+                int count = static_cast<int>(std::min<long long>(given, part.ready_parties - part.free_instances));
+                part.free_instances += count;
+                given -= count;
+            }
+        }
+        migrated_instances += moving;
+    }
+
+public:
+    ParallelSimulation(const SimulationConfig& cfg, int threads, double lookahead_seconds)
+        : config(cfg), lookahead(lookahead_seconds) {
+        config.regions = std::max(1, config.regions);
+        partition_count = std::max(1, std::min(threads, config.regions));
+        horizon = config.scenario ? std::ceil(config.scenario->duration) : config.runtime_seconds;
+        
+        partitions.resize(partition_count);
+        int offset = 0;
+        for (int k = 0; k < partition_count; k++) {
+            Partition& part = partitions[k];
+            part.index = k;
+            part.region_count = (config.regions - k + partition_count - 1) / partition_count;
+            part.region_offset = offset;
+            offset += part.region_count;
+            part.gen.seed(config.seed + 0x9e3779b97f4a7c15ULL * k);
+            for (auto& queues : part.role_queues) {
+                queues.resize(part.region_count);
+            }
+            for (auto& buffer : part.outbox) {
+                buffer.resize(partition_count);
+            }
+            part.capacity = shareOf(part, config.instances);
+            part.free_instances = part.capacity;
+            part.next_batch = k;
+        }
+    }
+    
+    int partitionCount() const {
+        return partition_count;
+    }
+    
+    Stats run() {
+        auto wall_start = std::chrono::steady_clock::now();
+        const ScenarioSchedule* scenario = config.scenario.get();
+        long long window_count = static_cast<long long>(std::ceil(horizon / lookahead));
+        std::barrier sync(partition_count, [this]() noexcept { migrateInstances(); });
+        
+        auto worker = [&](int k) {
+            Partition& part = partitions[k];
+            int initial[3]{config.tanks, config.healers, config.dps};
+            for (int role = 0; role < 3; role++) {
+                for (int i = k; i < initial[role]; i += partition_count) {
+                    post(part, 0, 0.0, role);
+                }
+            }
+            if (scenario != nullptr) {
+                part.next_arrival = scenario->nextArrival(part.cumulative, part.segment,
+                                                          part.gen.exponential() * partition_count);
+            }
+            generate(part, 0, windowEnd(0));
+            sync.arrive_and_wait();
+            
+            for (long long window = 0; window < window_count; window++) {
+                processWindow(part, window);
+                sync.arrive_and_wait();
+            }
+            part.capacity_seconds += usableInstances(part) * (horizon - part.last_time);
+        };
         
-        for (auto& instance : instances) {
-            instance.join();
+        std::vector<std::thread> runners;
+        for (int k = 1; k < partition_count; k++) {
+            runners.emplace_back(worker, k);
+        }
+        worker(0);
+        for (auto& runner : runners) {
+            runner.join();
         }
         
-        displayFinalSummary();
+        Stats stats;
+        stats.partitions = partition_count;
+        stats.windows = window_count;
+        stats.migrated_instances = migrated_instances;
+        SimulationResult& result = stats.result;
+        double busy_time = 0.0;
+        double capacity_seconds = 0.0;
+        std::vector<double> waits;
+        for (auto& part : partitions) {
+            result.parties += part.parties;
+            busy_time += part.busy_time;
+            capacity_seconds += part.capacity_seconds;
+            stats.events += part.events;
+            stats.remote_players += part.remote_players;
+            for (int role = 0; role < 3; role++) {
+                for (const auto& queue : part.role_queues[role]) {
+                    result.leftover[role] += static_cast<long long>(queue.size());
+                }
+            }
+            waits.insert(waits.end(), part.waits.begin(), part.waits.end());
+            std::vector<double>().swap(part.waits);
+            std::string shard = std::to_string(part.index);
+            stats.shard_sketches.emplace_back("wait/shard" + shard, part.wait_sketch);
+            stats.shard_sketches.emplace_back("duration/shard" + shard, part.duration_sketch);
+        }
+        auto merge_start = std::chrono::steady_clock::now();
+        for (auto& part : partitions) {
+            stats.wait_sketch.merge(part.wait_sketch);
+            stats.duration_sketch.merge(part.duration_sketch);
+        }
+        stats.merge_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - merge_start).count();
+        result.utilization = capacity_seconds > 0 ? busy_time / capacity_seconds : 0.0;
+        if (!waits.empty()) {
+            double total = 0.0;
+            for (double wait : waits) {
+                total += wait;
+            }
+            result.mean_wait = total / waits.size();
+            size_t rank = static_cast<size_t>(std::ceil(0.99 * waits.size())) - 1;
+            std::nth_element(waits.begin(), waits.begin() + rank, waits.end());
+            result.p99_wait = waits[rank];
+        }
+        result.elapsed_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - wall_start).count();
+        return stats;
     }
+};
+
+struct QueuePrediction {
+    double parties{0.0};
+    double utilization{0.0};
+    double mean_wait{0.0};
+    double p99_wait{0.0};
+    double leftover[3]{0.0, 0.0, 0.0};
+    int bottleneck_role{0};
+    bool capacity_bound{false};
+};
+
+double erlangC(int servers, double offered_load) {
+    double blocking = 1.0;
+    for (int i = 1; i <= servers; i++) {
+        blocking = offered_load * blocking / (i + offered_load * blocking);
+        if (blocking < 1e-15) {
+            return 0.0;
+        }
+    }
+    double rho = offered_load / servers;
+    return blocking / (1.0 - rho * (1.0 - blocking));
+}
+
+double normalPdf(double x) {
+    return std::exp(-0.5 * x * x) / std::sqrt(2.0 * M_PI);
+}
+
+double normalCdf(double x) {
+    return 0.5 * std::erfc(-x / std::sqrt(2.0));
+}
+
+struct NormalMin {
+    double mean;
+    double variance;
+    std::vector<double> covariance;
+};
 
-    void displayFinalSummary() {
-        std::cout << "\n\n=== FINAL SUMMARY ===" << std::endl;
-        std::cout << std::setw(12) << "Instance" 
-                  << std::setw(15) << "Status" 
-                  << std::setw(18) << "Parties Served" 
-                  << std::setw(16) << "Total Time" << std::endl;
-        std::cout << std::string(60, '-') << std::endl;
+NormalMin minOfNormals(const std::vector<double>& means, const std::vector<std::vector<double>>& cov,
+                       const std::vector<int>& members) {
+    NormalMin running{means[members[0]], cov[members[0]][members[0]], cov[members[0]]};
+    
+    for (size_t m = 1; m < members.size(); m++) {
+        int j = members[m];
+        double theta2 = running.variance + cov[j][j] - 2.0 * running.covariance[j];
+        if (theta2 < 1e-12) {
+            if (means[j] < running.mean) {
+                running = {means[j], cov[j][j], cov[j]};
+            }
+            continue;
+        }
         
-        int total_parties = 0;
-        int overall_time = 0;
+        double theta = std::sqrt(theta2);
+        double beta = (means[j] - running.mean) / theta;
+        double pick_running = normalCdf(beta);
+        double pick_other = 1.0 - pick_running;
+        double density = normalPdf(beta);
+        
+        double mean = running.mean * pick_running + means[j] * pick_other - theta * density;
+        double second = (running.mean * running.mean + running.variance) * pick_running +
+                        (means[j] * means[j] + cov[j][j]) * pick_other -
+                        (running.mean + means[j]) * theta * density;
+        for (size_t k = 0; k < running.covariance.size(); k++) {
+            running.covariance[k] = running.covariance[k] * pick_running + cov[j][k] * pick_other;
+        }
+        running.mean = mean;
+        running.variance = std::max(0.0, second - mean * mean);
+    }
+    return running;
+}
+
+QueuePrediction predictQueueModel(const SimulationConfig& config) {
+    static constexpr int party_roles[3]{1, 1, 3};
+    const int time_points = 32;
+    QueuePrediction prediction;
+    
+    double horizon = config.runtime_seconds;
+    double interval = config.interval_ms / 1000.0;
+    double mean_batch = (config.min_batch + config.max_batch) / 2.0;
+    double batch_span = config.max_batch - config.min_batch + 1.0;
+    double batch_variance = (batch_span * batch_span - 1.0) / 12.0;
+    double weight_total = config.role_weights[0] + config.role_weights[1] + config.role_weights[2];
+    double initial[3]{static_cast<double>(config.tanks), static_cast<double>(config.healers),
+                      static_cast<double>(config.dps)};
+    
+    double share[3];
+    double role_rate[3];
+    double party_rate = std::numeric_limits<double>::max();
+    for (int role = 0; role < 3; role++) {
+        share[role] = config.role_weights[role] / weight_total;
+        role_rate[role] = mean_batch * share[role] / interval;
+        if (role_rate[role] / party_roles[role] < party_rate) {
+            party_rate = role_rate[role] / party_roles[role];
+            prediction.bottleneck_role = role;
+        }
+    }
+    
+    double mean_service = (config.min_time + config.max_time) / 2.0;
+    double service_span = config.max_time - config.min_time + 1.0;
+    double service_cv2 = mean_service > 0
+        ? (service_span * service_span - 1.0) / 12.0 / (mean_service * mean_service) : 0.0;
+    double capacity_rate = mean_service > 0 ? config.instances / mean_service : std::numeric_limits<double>::max();
+    prediction.capacity_bound = capacity_rate < party_rate;
+    
+    double service_wait = 0.0;
+    double offered_load = party_rate * mean_service;
+    if (mean_service > 0 && offered_load < 0.95 * config.instances) {
+        int b = prediction.bottleneck_role;
+        double count_variance = share[b] * (1.0 - share[b]) * mean_batch + share[b] * share[b] * batch_variance;
+        double arrival_cv2 = count_variance / (share[b] * mean_batch) / party_roles[b];
+        double wait_probability = erlangC(config.instances, offered_load);
+        service_wait = wait_probability / (capacity_rate - party_rate) * (arrival_cv2 + service_cv2) / 2.0;
+    }
+    
+    auto stateAt = [&](double t, std::vector<double>& means, std::vector<std::vector<double>>& cov) {
+        double batches = std::floor(t / interval) + 1.0;
+        means.assign(4, 0.0);
+        cov.assign(4, std::vector<double>(4, 0.0));
+        for (int a = 0; a < 3; a++) {
+            means[a] = (initial[a] + batches * mean_batch * share[a]) / party_roles[a];
+            for (int b = 0; b < 3; b++) {
+                double per_batch = a == b
+                    ? share[a] * (1.0 - share[a]) * mean_batch + share[a] * share[a] * batch_variance
+                    : share[a] * share[b] * (batch_variance - mean_batch);
+                cov[a][b] = batches * per_batch / (party_roles[a] * party_roles[b]);
+            }
+        }
+        means[3] = mean_service > 0 ? config.instances * (1.0 + t / mean_service) : std::numeric_limits<double>::max() / 4;
+        cov[3][3] = mean_service > 0 ? config.instances * t * service_cv2 / mean_service : 0.0;
+    };
+    
+    struct WaitSample {
+        double weight;
+        double shift;
+        double scale;
+        double mean;
+        double sd;
+        double limit;
+    };
+    std::vector<WaitSample> wait_samples;
+    std::vector<double> means;
+    std::vector<std::vector<double>> cov;
+    
+    for (int point = 0; point <= time_points; point++) {
+        double t = horizon * point / time_points;
+        stateAt(t, means, cov);
+        bool final_point = point == time_points;
         
-        for (int i = 0; i < dungeon_count; i++) {
-            std::cout << std::setw(10) << (i + 1) 
-                      << std::setw(15) << (dungeon_active[i] ? "ACTIVE" : "EMPTY")
-                      << std::setw(15) << parties_served[i] 
-                      << std::setw(15) << total_time_served[i] << "s" << std::endl;
+        for (int role = 0; role < 3; role++) {
+            std::vector<int> others;
+            for (int j = 0; j < 4; j++) {
+                if (j != role) {
+                    others.push_back(j);
+                }
+            }
+            NormalMin limit = minOfNormals(means, cov, others);
+            double supply_rate = std::numeric_limits<double>::max();
+            bool capacity_limited = true;
+            for (int j = 0; j < 3; j++) {
+                if (j != role) {
+                    supply_rate = std::min(supply_rate, role_rate[j] / party_roles[j]);
+                    capacity_limited = capacity_limited && means[3] < means[j];
+                }
+            }
+            double drain_rate = capacity_limited ? capacity_rate : std::min(supply_rate, capacity_rate);
+            double mean = means[role] - limit.mean;
+            double sd = std::sqrt(std::max(1e-12, cov[role][role] + limit.variance - 2.0 * limit.covariance[role]));
+            
+            if (final_point) {
+                double z = mean / sd;
+                prediction.leftover[role] = party_roles[role] * (mean * normalCdf(z) + sd * normalPdf(z)) +
+                                            (party_roles[role] - 1) / 2.0 * normalCdf(-z);
+                continue;
+            }
             
-            total_parties += parties_served[i];
-            overall_time += total_time_served[i];
+            double gather_wait = party_roles[role] > 1 && role_rate[role] > 0
+                ? (party_roles[role] - 1) / (2.0 * role_rate[role]) : 0.0;
+            double slice_weight = role_rate[role] * horizon / time_points;
+            if (point == 0 && initial[role] > 0) {
+                wait_samples.push_back({initial[role], service_wait, 1.0 / drain_rate,
+                                        mean / 2.0, sd, horizon});
+            }
+            wait_samples.push_back({slice_weight, gather_wait + service_wait,
+                                    1.0 / drain_rate, mean, sd, horizon - t});
+        }
+    }
+    
+    // Dungeons still running at the horizon only count up to it, as in the
+    // simulator, so each time point's new parties add their expected
+    // service clipped to the time left.
+    auto clippedService = [&](double remaining) {
+        double total = 0.0;
+        for (int duration = config.min_time; duration <= config.max_time; duration++) {
+            total += std::min<double>(duration, remaining);
+        }
+        return total / (config.max_time - config.min_time + 1);
+    };
+    double busy_time = 0.0;
+    double formed = 0.0;
+    for (int point = 0; point <= time_points; point++) {
+        double t = horizon * point / time_points;
+        stateAt(t, means, cov);
+        double parties = std::max(formed, minOfNormals(means, cov, {0, 1, 2, 3}).mean);
+        busy_time += (parties - formed) * clippedService(horizon - t);
+        formed = parties;
+    }
+    prediction.parties = std::floor(formed);
+    prediction.utilization = mean_service > 0 ? std::min(1.0, busy_time / (config.instances * horizon)) : 0.0;
+    
+    auto matchedBy = [](const WaitSample& s, double wait) {
+        double reach = (wait - s.shift) / s.scale;
+        if (reach < 0) {
+            return 0.0;
         }
+        return normalCdf((reach - s.mean) / s.sd);
+    };
+    
+    double matched_weight = 0.0;
+    double total_wait = 0.0;
+    std::vector<double> matched_share;
+    for (const auto& s : wait_samples) {
+        matched_share.push_back(matchedBy(s, s.limit));
+        double limit = (s.limit - s.shift) / s.scale;
+        if (limit <= 0) {
+            continue;
+        }
+        double lower = -s.mean / s.sd;
+        double upper = (limit - s.mean) / s.sd;
+        double matched = normalCdf(upper);
+        double queued_mass = normalCdf(upper) - normalCdf(lower);
+        double queued_mean = s.mean * queued_mass + s.sd * (normalPdf(lower) - normalPdf(upper));
+        matched_weight += s.weight * matched;
+        total_wait += s.weight * (s.shift * matched + s.scale * std::max(0.0, queued_mean));
+    }
+    
+    if (matched_weight > 0) {
+        prediction.mean_wait = total_wait / matched_weight;
         
-        std::cout << std::string(60, '-') << std::endl;
-        std::cout << std::setw(25) << "TOTAL" 
-                  << std::setw(15) << total_parties 
-                  << std::setw(15) << overall_time << "s" << std::endl;
-        std::cout << "Remaining players - Tanks: " << tank_queue
-                  << ", Healers: " << healer_queue
-                  << ", DPS: " << dps_queue << std::endl;
-        std::cout << "Total players added by producer: " << total_players_added << std::endl;
-        std::cout << "Total parties formed: " << total_parties_formed << std::endl;
+        double low = 0.0;
+        double high = horizon;
+        for (int iteration = 0; iteration < 32; iteration++) {
+            double wait = (low + high) / 2.0;
+            double below = 0.0;
+            for (size_t i = 0; i < wait_samples.size(); i++) {
+                below += wait_samples[i].weight * std::min(matchedBy(wait_samples[i], wait), matched_share[i]);
+            }
+            if (below >= 0.99 * matched_weight) {
+                high = wait;
+            } else {
+                low = wait;
+            }
+        }
+        prediction.p99_wait = high;
+    }
+    return prediction;
+}
+
+void runPredictionComparison(const SimulationConfig& config, int replications) {
+    static const char* role_names[3]{"Tanks", "Healers", "DPS"};
+    
+    const int timing_rounds = 100;
+    QueuePrediction prediction = predictQueueModel(config);
+    auto predict_start = std::chrono::steady_clock::now();
+    for (int round = 0; round < timing_rounds; round++) {
+        prediction = predictQueueModel(config);
+    }
+    double predict_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - predict_start).count() / timing_rounds;
+    
+    SimulationResult average;
+    double simulate_ms = 0.0;
+    std::vector<double> pooled_waits;
+    for (int r = 0; r < replications; r++) {
+        SimulationConfig replica = config;
+        replica.seed = config.seed + r;
+        VirtualSimulation simulation(replica);
+        SimulationResult result = simulation.run();
+        pooled_waits.insert(pooled_waits.end(), simulation.playerWaits().begin(), simulation.playerWaits().end());
+        average.parties += result.parties;
+        average.utilization += result.utilization / replications;
+        average.mean_wait += result.mean_wait / replications;
+        for (int role = 0; role < 3; role++) {
+            average.leftover[role] += result.leftover[role];
+        }
+        simulate_ms += result.elapsed_ms;
+    }
+    if (!pooled_waits.empty()) {
+        size_t rank = static_cast<size_t>(std::ceil(0.99 * pooled_waits.size())) - 1;
+        std::nth_element(pooled_waits.begin(), pooled_waits.begin() + rank, pooled_waits.end());
+        average.p99_wait = pooled_waits[rank];
+    }
+    
+    auto row = [](const std::string& name, double predicted, double simulated) {
+        double error = simulated != 0 ? (predicted - simulated) / std::fabs(simulated) * 100.0 : 0.0;
+        std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(14) << predicted << std::setw(14) << simulated
+                  << std::setprecision(1) << std::setw(11) << error << "%" << std::endl;
+    };
+    
+    std::cout << "\n=== QUEUE MODEL PREDICTION ===" << std::endl;
+    std::cout << "Instances: " << config.instances << " | Arrivals: " << config.min_batch << "-"
+              << config.max_batch << " players every " << config.interval_ms << " ms"
+              << " | Dungeon time: " << config.min_time << "s to " << config.max_time << "s"
+              << " | Horizon: " << config.runtime_seconds << "s" << std::endl;
+    std::cout << "Bottleneck: " << (prediction.capacity_bound ? "instance capacity" : role_names[prediction.bottleneck_role])
+              << std::endl;
+    if (prediction.capacity_bound && config.runtime_seconds < 4 * config.max_time) {
+        std::cout << "Warning: capacity bound over fewer than four dungeon lengths; the model assumes instances free up"
+                  << " evenly from the start, so expect errors of 20-50% in parties and leftover roles." << std::endl;
     }
+    std::cout << std::left << std::setw(20) << "Metric" << std::right << std::setw(14) << "Predicted"
+              << std::setw(14) << "Simulated" << std::setw(12) << "Error" << std::endl;
+    std::cout << std::string(60, '-') << std::endl;
+    row("Parties", prediction.parties, static_cast<double>(average.parties) / replications);
+    row("Utilization", prediction.utilization, average.utilization);
+    row("Mean wait (s)", prediction.mean_wait, average.mean_wait);
+    row("p99 wait (s)", prediction.p99_wait, average.p99_wait);
+    for (int role = 0; role < 3; role++) {
+        row(std::string("Leftover ") + role_names[role], prediction.leftover[role],
+            static_cast<double>(average.leftover[role]) / replications);
+    }
+    std::cout << std::string(60, '-') << std::endl;
+    std::cout << "Prediction took " << std::setprecision(1) << predict_us << " us; "
+              << replications << " simulation run(s) took " << simulate_ms << " ms" << std::endl;
+}
+
+void runBatchWindowReport(const SimulationConfig& base, int replications) {
+    const int windows_ms[]{0, 250, 500, 1000, 2000, 5000};
+    
+    std::cout << "\n=== MATCHING WINDOW REPORT ===" << std::endl;
+    std::cout << "Instances: " << base.instances << " | Regions: " << base.regions << " | Arrivals: "
+              << base.min_batch << "-" << base.max_batch << " players every " << base.interval_ms
+              << " ms | Budget: " << base.match_budget_us << " us per window | Runs: " << replications << std::endl;
+    std::cout << std::setw(10) << "Window" << std::setw(10) << "Parties" << std::setw(12) << "Mean wait"
+              << std::setw(11) << "p99 wait" << std::setw(13) << "Mean spread" << std::setw(12) << "p95 spread"
+              << std::setw(14) << "Matcher us" << std::endl;
+    std::cout << std::string(82, '-') << std::endl;
+    
+    for (int window_ms : windows_ms) {
+        SimulationResult average;
+        for (int r = 0; r < replications; r++) {
+            SimulationConfig replica = base;
+            replica.match_window_ms = window_ms;
+            replica.seed = base.seed + r;
+            SimulationResult result = VirtualSimulation(replica).run();
+            average.parties += result.parties;
+            average.mean_wait += result.mean_wait / replications;
+            average.p99_wait += result.p99_wait / replications;
+            average.mean_spread += result.mean_spread / replications;
+            average.p95_spread += result.p95_spread / replications;
+            average.matcher_us += result.match_rounds > 0 ? result.matcher_us / result.match_rounds / replications : 0.0;
+        }
+        
+        std::cout << std::setw(10) << (window_ms == 0 ? std::string("greedy") : std::to_string(window_ms) + "ms")
+                  << std::setw(10) << average.parties / replications << std::fixed << std::setprecision(2)
+                  << std::setw(12) << average.mean_wait << std::setw(11) << average.p99_wait
+                  << std::setprecision(1) << std::setw(13) << average.mean_spread << std::setw(12) << average.p95_spread
+                  << std::setw(14) << (window_ms == 0 ? std::string("-") : std::to_string(static_cast<int>(average.matcher_us)))
+                  << std::endl;
+    }
+    std::cout << std::string(82, '-') << std::endl;
+    std::cout << "Spread is the MMR range inside a party; matcher time is wall time per matching window." << std::endl;
+}
+
+void runTickReport(const SimulationConfig& base, int replications) {
+    const int ticks_ms[]{0, 10, 50, 100, 250, 500, 1000};
+
+    std::cout << "\n=== TICK GRANULARITY REPORT ===" << std::endl;
+    std::cout << "Instances: " << base.instances << " | Regions: " << base.regions << " | Runtime: "
+              << (base.scenario ? std::ceil(base.scenario->duration) : base.runtime_seconds) << "s | Runs: "
+              << replications << std::endl;
+    std::cout << std::setw(8) << "Tick" << std::setw(10) << "Parties" << std::setw(12) << "Mean wait"
+              << std::setw(11) << "p99 wait" << std::setw(12) << "Wait cost" << std::setw(11) << "Wall ms"
+              << std::setw(14) << "Players/s" << std::setw(10) << "Speedup" << std::endl;
+    std::cout << std::string(88, '-') << std::endl;
+
+    double event_wait = 0.0;
+    double event_ms = 0.0;
+    for (int tick_ms : ticks_ms) {
+        SimulationResult average;
+        double players = 0.0;
+        for (int r = 0; r < replications; r++) {
+            SimulationConfig replica = base;
+            replica.tick_ms = tick_ms;
+            replica.seed = base.seed + r;
+            SimulationResult result = VirtualSimulation(replica).run();
+            average.parties += result.parties;
+            average.mean_wait += result.mean_wait / replications;
+            average.p99_wait += result.p99_wait / replications;
+            average.elapsed_ms += result.elapsed_ms / replications;
+            players += result.parties * 5.0 + result.leftover[0] + result.leftover[1] + result.leftover[2];
+        }
+        if (tick_ms == 0) {
+            event_wait = average.mean_wait;
+            event_ms = average.elapsed_ms;
+        }
+
+        std::cout << std::setw(8) << (tick_ms == 0 ? std::string("event") : std::to_string(tick_ms) + "ms")
+                  << std::setw(10) << average.parties / replications << std::fixed << std::setprecision(2)
+                  << std::setw(12) << average.mean_wait << std::setw(11) << average.p99_wait
+                  << std::showpos << std::setw(12) << average.mean_wait - event_wait << std::noshowpos
+                  << std::setprecision(1) << std::setw(11) << average.elapsed_ms << std::setprecision(0)
+                  << std::setw(14) << players / replications / (average.elapsed_ms / 1000.0)
+                  << std::setprecision(2) << std::setw(9) << event_ms / average.elapsed_ms << "x" << std::endl;
+    }
+    std::cout << std::string(88, '-') << std::endl;
+    std::cout << "Wait cost is the extra mean wait over event-driven matching; speedup is simulation wall time"
+              << " saved by batching each tick." << std::endl;
+}
+
+struct CapacityProbe {
+    int instances{0};
+    int replications{0};
+    double mean_p99{0.0};
+    double lower{0.0};
+    double upper{0.0};
+    bool meets_slo{false};
+    bool decisive{false};
 };
 
+CapacityProbe evaluateCapacity(const SimulationConfig& base, int instances, double slo_seconds,
+                               int max_replications, int threads) {
+    const int min_replications = 5;
+    CapacityProbe probe;
+    probe.instances = instances;
+    std::vector<double> p99_samples;
+    
+    while (static_cast<int>(p99_samples.size()) < max_replications) {
+        int batch = std::min(threads, max_replications - static_cast<int>(p99_samples.size()));
+        std::vector<double> batch_results(batch);
+        std::vector<std::thread> runners;
+        for (int b = 0; b < batch; b++) {
+            SimulationConfig replica = base;
+            replica.instances = instances;
+            replica.seed = base.seed + p99_samples.size() + b;
+            runners.emplace_back([replica, &batch_results, b]() {
+                batch_results[b] = VirtualSimulation(replica).run().p99_wait;
+            });
+        }
+        for (auto& runner : runners) {
+            runner.join();
+        }
+        p99_samples.insert(p99_samples.end(), batch_results.begin(), batch_results.end());
+        
+        int count = static_cast<int>(p99_samples.size());
+        double mean = 0.0;
+        for (double sample : p99_samples) {
+            mean += sample / count;
+        }
+        double variance = 0.0;
+        for (double sample : p99_samples) {
+            variance += (sample - mean) * (sample - mean) / std::max(1, count - 1);
+        }
+        double half_width = 1.96 * std::sqrt(variance / count);
+        
+        probe.replications = count;
+        probe.mean_p99 = mean;
+        probe.lower = mean - half_width;
+        probe.upper = mean + half_width;
+        probe.meets_slo = mean < slo_seconds;
+        if (count >= min_replications && (probe.upper < slo_seconds || probe.lower > slo_seconds)) {
+            probe.decisive = true;
+            break;
+        }
+    }
+    return probe;
+}
+
+void runCapacityPlanner(const SimulationConfig& base, double slo_seconds, int max_instances,
+                        int max_replications, int threads) {
+    std::cout << "\n=== CAPACITY PLAN ===" << std::endl;
+    std::cout << "Target: p99 wait < " << slo_seconds << "s | Arrivals: " << base.min_batch << "-"
+              << base.max_batch << " players every " << base.interval_ms << " ms | Dungeon time: "
+              << base.min_time << "s to " << base.max_time << "s | Horizon: " << base.runtime_seconds
+              << "s | Threads: " << threads << std::endl;
+    std::cout << std::setw(10) << "Instances" << std::setw(8) << "Runs" << std::setw(12) << "p99 wait"
+              << std::setw(24) << "95% CI" << "  Verdict" << std::endl;
+    std::cout << std::string(64, '-') << std::endl;
+    
+    std::map<int, CapacityProbe> probes;
+    auto probe = [&](int instances) -> const CapacityProbe& {
+        auto it = probes.find(instances);
+        if (it != probes.end()) {
+            return it->second;
+        }
+        CapacityProbe result = evaluateCapacity(base, instances, slo_seconds, max_replications, threads);
+        std::ostringstream interval;
+        interval << std::fixed << std::setprecision(2) << "[" << result.lower << ", " << result.upper << "]";
+        std::cout << std::setw(10) << instances << std::setw(8) << result.replications << std::fixed
+                  << std::setprecision(2) << std::setw(12) << result.mean_p99 << std::setw(24) << interval.str()
+                  << "  " << (result.meets_slo ? "meets" : "misses")
+                  << (result.decisive ? "" : " (not significant)") << std::endl;
+        return probes.emplace(instances, result).first->second;
+    };
+    
+    auto plan_start = std::chrono::steady_clock::now();
+    const CapacityProbe& largest = probe(max_instances);
+    if (!largest.meets_slo) {
+        std::cout << std::string(64, '-') << std::endl;
+        std::cout << "Target not reachable with " << max_instances << " instances; waits are limited by "
+                  << "role supply rather than capacity (raise --max-instances or change the role mix)." << std::endl;
+        return;
+    }
+    
+    int low = 1;
+    int high = max_instances;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (probe(mid).meets_slo) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    
+    double plan_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - plan_start).count();
+    const CapacityProbe& chosen = probes.at(high);
+    std::cout << std::string(64, '-') << std::endl;
+    std::cout << "Recommended instances: " << high << " (p99 wait " << std::setprecision(2) << chosen.mean_p99
+              << "s, 95% CI " << chosen.lower << "s to " << chosen.upper << "s)" << std::endl;
+    if (high > 1) {
+        const CapacityProbe& below = probe(high - 1);
+        std::cout << "With " << (high - 1) << " instances: p99 wait " << below.mean_p99 << "s (95% CI "
+                  << below.lower << "s to " << below.upper << "s)" << std::endl;
+    }
+    if (!chosen.decisive) {
+        std::cout << "Note: the recommendation is within noise of the target; raise --replications for a sharper answer."
+                  << std::endl;
+    }
+    std::cout << "Planning took " << std::setprecision(2) << plan_seconds << "s over " << probes.size()
+              << " probed instance counts." << std::endl;
+}
+
+bool runSingleSimulation(const SimulationConfig& config, const std::string& event_log_path,
+                         const std::string& sketch_path) {
+    static const char* role_names[]{"Tanks", "Healers", "DPS"};
+    VirtualSimulation simulation(config);
+    if (!sketch_path.empty()) {
+        simulation.enableSketches();
+    }
+    ColumnarEventLog event_log;
+    if (!event_log_path.empty()) {
+        if (!event_log.open(event_log_path)) {
+            std::cerr << "Cannot open " << event_log_path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        // The simulated day starts at the most recent UTC midnight.
+        auto midnight = std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now());
+        simulation.setEventLog(&event_log, std::chrono::duration_cast<std::chrono::microseconds>(
+            midnight.time_since_epoch()).count());
+    }
+    SimulationResult result = simulation.run();
+    
+    std::cout << "\n=== VIRTUAL-TIME SIMULATION ===" << std::endl;
+    if (config.scenario) {
+        std::cout << "Scenario: " << config.scenario->duration << "s, " << config.scenario->segments.size()
+                  << " arrival segments, " << config.scenario->events.size() << " events, "
+                  << std::fixed << std::setprecision(0) << config.scenario->expectedArrivals()
+                  << " expected arrivals" << std::endl;
+    }
+    std::cout << "Instances: " << config.instances << " | Dungeon time: " << config.min_time << "s to "
+              << config.max_time << "s | Seed: " << config.seed << std::endl;
+    std::cout << "Parties formed: " << result.parties << std::endl;
+    std::cout << "Utilization: " << std::fixed << std::setprecision(3) << result.utilization << std::endl;
+    std::cout << "Wait - mean: " << std::setprecision(2) << result.mean_wait << "s, p99: "
+              << result.p99_wait << "s" << std::endl;
+    std::cout << "Leftover -";
+    for (int role = 0; role < 3; role++) {
+        std::cout << (role > 0 ? ", " : " ") << role_names[role] << ": " << result.leftover[role];
+    }
+    std::cout << std::endl;
+    std::cout << "Simulated in " << std::setprecision(1) << result.elapsed_ms << " ms" << std::endl;
+    if (!event_log_path.empty()) {
+        if (!event_log.close()) {
+            std::cerr << "Failed to write " << event_log_path << std::endl;
+            return false;
+        }
+        std::cout << "Event log: " << event_log.rowsWritten() << " rows written to " << event_log_path << std::endl;
+    }
+    if (!sketch_path.empty()) {
+        NamedSketches sketches = simulation.sketches();
+        DDSketch all_waits;
+        for (int role = 0; role < 3; role++) {
+            all_waits.merge(sketches[role].second);
+        }
+        std::cout << "Wait p99 from merged role sketches: " << std::setprecision(2) << all_waits.quantile(0.99)
+                  << "s (exact " << result.p99_wait << "s)" << std::endl;
+        return writeSketchFile(sketch_path, sketches);
+    }
+    return true;
+}
+
+bool runParallelSimulation(const SimulationConfig& config, int max_threads, int replications, int lookahead_ms,
+                           const std::string& sketch_path) {
+    double lookahead = lookahead_ms / 1000.0;
+    // More threads than partitions would only rerun the widest simulation.
+    int widest = ParallelSimulation(config, max_threads, lookahead).partitionCount();
+    std::vector<int> thread_counts;
+    for (int threads = 1; threads < widest; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(widest);
+    
+    std::cout << "\n=== PARALLEL SIMULATION ===" << std::endl;
+    std::cout << "Instances: " << config.instances << " | Regions: " << config.regions << " | Lookahead: "
+              << lookahead_ms << " ms | Hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+    if (widest < max_threads) {
+        std::cout << "Note: partitions are capped at --regions=" << config.regions << "." << std::endl;
+    }
+    if (widest < 2) {
+        std::cout << "Note: a single partition has no speedup curve; use --regions=N and --threads=N with N >= 2."
+                  << std::endl;
+    }
+    // An untimed run first, so the single-thread baseline does not pay for
+    // cold caches and first-touch page faults.
+    ParallelSimulation(config, 1, lookahead).run();
+    std::cout << std::setw(8) << "Threads" << std::setw(12) << "Partitions" << std::setw(12) << "Wall ms"
+              << std::setw(14) << "Events/s" << std::setw(10) << "Speedup" << std::setw(12) << "Efficiency"
+              << std::setw(10) << "Remote" << std::setw(12) << "Migrated" << std::endl;
+    std::cout << std::string(90, '-') << std::endl;
+    
+    double baseline_ms = 0.0;
+    ParallelSimulation::Stats stats;
+    for (int threads : thread_counts) {
+        stats = ParallelSimulation(config, threads, lookahead).run();
+        double wall_ms = stats.result.elapsed_ms;
+        if (threads == 1) {
+            baseline_ms = wall_ms;
+        }
+        double arrivals = static_cast<double>(stats.result.parties) * 5 +
+                          stats.result.leftover[0] + stats.result.leftover[1] + stats.result.leftover[2];
+        std::cout << std::setw(8) << threads << std::setw(12) << stats.partitions << std::fixed
+                  << std::setprecision(1) << std::setw(12) << wall_ms << std::setprecision(0)
+                  << std::setw(14) << stats.events / (wall_ms / 1000.0) << std::setprecision(2)
+                  << std::setw(9) << baseline_ms / wall_ms << "x" << std::setprecision(1)
+                  << std::setw(11) << baseline_ms / wall_ms / stats.partitions * 100.0 << "%"
+                  << std::setw(9) << (arrivals > 0 ? stats.remote_players / arrivals * 100.0 : 0.0) << "%"
+                  << std::setw(12) << stats.migrated_instances << std::endl;
+    }
+    std::cout << std::string(90, '-') << std::endl;
+    
+    double sketch_p99 = stats.wait_sketch.quantile(0.99);
+    std::cout << "Shard sketches (" << stats.partitions << " partitions) merged in " << std::setprecision(1)
+              << stats.merge_us << " us - wait p50 " << std::setprecision(2) << stats.wait_sketch.quantile(0.5)
+              << "s, p99 " << sketch_p99 << "s (exact " << stats.result.p99_wait << "s, "
+              << std::showpos << std::setprecision(2)
+              << (stats.result.p99_wait > 0 ? (sketch_p99 / stats.result.p99_wait - 1.0) * 100.0 : 0.0)
+              << std::noshowpos << "%), dungeon time p50 " << stats.duration_sketch.quantile(0.5) << "s" << std::endl;
+    bool sketches_written = sketch_path.empty() || writeSketchFile(sketch_path, stats.shard_sketches);
+    
+    struct Sample {
+        const char* name;
+        std::vector<double> sequential;
+        std::vector<double> parallel;
+    };
+    Sample samples[]{{"Parties", {}, {}}, {"Utilization", {}, {}}, {"Mean wait (s)", {}, {}}, {"p99 wait (s)", {}, {}}};
+    double sequential_ms = 0.0;
+    double parallel_ms = 0.0;
+    for (int r = 0; r < replications; r++) {
+        SimulationConfig replica = config;
+        replica.seed = config.seed + r;
+        SimulationResult results[2]{VirtualSimulation(replica).run(),
+                                    ParallelSimulation(replica, max_threads, lookahead).run().result};
+        sequential_ms += results[0].elapsed_ms;
+        parallel_ms += results[1].elapsed_ms;
+        for (int engine = 0; engine < 2; engine++) {
+            const SimulationResult& result = results[engine];
+            double values[]{static_cast<double>(result.parties), result.utilization, result.mean_wait, result.p99_wait};
+            for (int metric = 0; metric < 4; metric++) {
+                (engine == 0 ? samples[metric].sequential : samples[metric].parallel).push_back(values[metric]);
+            }
+        }
+    }
+    
+    auto summarize = [](const std::vector<double>& values, double& mean, double& variance) {
+        int count = static_cast<int>(values.size());
+        mean = 0.0;
+        for (double value : values) {
+            mean += value / count;
+        }
+        variance = 0.0;
+        for (double value : values) {
+            variance += (value - mean) * (value - mean) / std::max(1, count - 1);
+        }
+    };
+    
+    std::cout << "Sequential vs parallel (" << max_threads << " threads) over " << replications << " seed(s):" << std::endl;
+    std::cout << std::left << std::setw(16) << "Metric" << std::right << std::setw(16) << "Sequential"
+              << std::setw(16) << "Parallel" << std::setw(12) << "Diff" << std::setw(14) << "95% bound" << std::endl;
+    bool consistent = true;
+    for (const auto& sample : samples) {
+        double sequential_mean, sequential_var, parallel_mean, parallel_var;
+        summarize(sample.sequential, sequential_mean, sequential_var);
+        summarize(sample.parallel, parallel_mean, parallel_var);
+        double diff = parallel_mean - sequential_mean;
+        double bound = 1.96 * std::sqrt((sequential_var + parallel_var) / replications);
+        // Allow 1% relative slack for metrics that barely vary between seeds.
+        bound = std::max(bound, 0.01 * std::fabs(sequential_mean));
+        bool within = std::fabs(diff) <= bound;
+        consistent = consistent && within;
+        std::cout << std::left << std::setw(16) << sample.name << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(16) << sequential_mean << std::setw(16) << parallel_mean << std::setw(12) << diff
+                  << std::setw(14) << bound << (within ? "" : "  differs") << std::endl;
+    }
+    std::cout << (consistent ? "Parallel results are statistically consistent with the sequential engine."
+                             : "Parallel results differ from the sequential engine beyond the 95% bound.")
+              << std::endl;
+    std::cout << "Sequential took " << std::setprecision(1) << sequential_ms / replications << " ms per run; parallel took "
+              << parallel_ms / replications << " ms per run." << std::endl;
+    return sketches_written;
+}
+
 bool isValidIntegerInput(const std::string& input) {
     if (input.empty()) {
         return false;
@@ -317,31 +1789,424 @@ int getValidatedIntegerWithRange(const std::string& prompt, int minValue) {
     }
 }
 
-int main() {
+bool parseIntOption(const std::string& arg, const std::string& name, int& value, int min_value = 1) {
+    std::string prefix = name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    
+    std::string text = arg.substr(prefix.size());
+    if (!isValidIntegerInput(text)) {
+        return false;
+    }
+    
+    std::stringstream ss(text);
+    int parsed;
+    if (!(ss >> parsed) || parsed < min_value) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+bool parseStringOption(const std::string& arg, const std::string& name, std::string& value) {
+    std::string prefix = name + "=";
+    if (arg.compare(0, prefix.size(), prefix) != 0 || arg.size() == prefix.size()) {
+        return false;
+    }
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+bool parseRoleMixOption(const std::string& arg, double weights[3]) {
+    std::string prefix = "--role-mix=";
+    if (arg.compare(0, prefix.size(), prefix) != 0) {
+        return false;
+    }
+    
+    std::stringstream ss(arg.substr(prefix.size()));
+    double parsed[3];
+    char separator;
+    if (!(ss >> parsed[0] >> separator >> parsed[1] >> separator >> parsed[2]) ||
+        parsed[0] < 0 || parsed[1] < 0 || parsed[2] < 0 || parsed[0] + parsed[1] + parsed[2] <= 0) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        weights[i] = parsed[i];
+    }
+    return true;
+}
+
+bool parseSimulationOption(const std::string& arg, SimulationConfig& config) {
+    int seed = static_cast<int>(config.seed);
+    if (parseIntOption(arg, "--instances", config.instances) ||
+        parseIntOption(arg, "--tanks", config.tanks, 0) ||
+        parseIntOption(arg, "--healers", config.healers, 0) ||
+        parseIntOption(arg, "--dps", config.dps, 0) ||
+        parseIntOption(arg, "--min-time", config.min_time, 0) ||
+        parseIntOption(arg, "--max-time", config.max_time, 0) ||
+        parseIntOption(arg, "--interval-ms", config.interval_ms) ||
+        parseIntOption(arg, "--runtime", config.runtime_seconds) ||
+        parseIntOption(arg, "--regions", config.regions) ||
+        parseIntOption(arg, "--match-window-ms", config.match_window_ms, 0) ||
+        parseIntOption(arg, "--match-budget-us", config.match_budget_us) ||
+        parseIntOption(arg, "--match-max-hold", config.match_max_hold_seconds, 0) ||
+        parseIntOption(arg, "--tick-ms", config.tick_ms, 0) ||
+        parseRoleMixOption(arg, config.role_weights)) {
+        return true;
+    }
+    if (parseIntOption(arg, "--seed", seed, 0)) {
+        config.seed = static_cast<uint64_t>(seed);
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
     int n, t, h, d, t1, t2;
+    bool prefault = false;
+    bool benchmark = false;
+    bool bench_json = false;
+    int bench_parties = 200000;
+    int bench_producers = 2;
+    int bench_instances = 8;
+    bool predict = false;
+    bool simulate = false;
+    bool parallel_sim = false;
+    bool regions_given = false;
+    int lookahead_ms = 100;
+    std::string scenario_path;
+    PageMode page_mode = PageMode::normal;
+    std::string page_mode_name;
+    int rate_limit = 0;
+    int rate_burst = 3;
+    int dedup_ms = 2000;
+    int accounts = 100000;
+    int spam_rate = 0;
+    bool account_stats = false;
+    int queue_timeout = 0;
+    std::string state_path;
+    int checkpoint_interval = 10;
+    bool plan = false;
+    bool batch_report = false;
+    bool tick_report = false;
+    int replications = 20;
+    int slo_p99 = 60;
+    int max_instances = 10000;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    int forecast_bucket_ms = 5000;
+    int forecast_horizon = 120;
+    bool forecast_warmup = true;
+    int dashboard_fps = 0;
+    bool full_status = false;
+    bool ndjson = false;
+    std::string ndjson_path;
+    std::string summary_json_path;
+    std::string summary_csv_path;
+    std::string event_log_path;
+    std::string sketch_path;
+    SimulationConfig sim_config;
     
-    std::cout << "=== MMORPG Dungeon LFG Queue System ===" << std::endl;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--prefault") {
+            prefault = true;
+        } else if (arg == "--bench") {
+            benchmark = true;
+        } else if (arg == "--bench-json") {
+            benchmark = true;
+            bench_json = true;
+        } else if (parseIntOption(arg, "--bench-parties", bench_parties) ||
+                   parseIntOption(arg, "--bench-producers", bench_producers) ||
+                   parseIntOption(arg, "--bench-instances", bench_instances)) {
+            continue;
+        } else if (arg == "--predict") {
+            predict = true;
+        } else if (parseIntOption(arg, "--queue-timeout", queue_timeout)) {
+            continue;
+        } else if (arg == "--hugepages") {
+            page_mode = PageMode::transparent;
+        } else if (parseStringOption(arg, "--hugepages", page_mode_name)) {
+            if (page_mode_name != "thp" && page_mode_name != "hugetlb") {
+                std::cerr << "--hugepages must be thp or hugetlb." << std::endl;
+                return 1;
+            }
+            page_mode = page_mode_name == "thp" ? PageMode::transparent : PageMode::hugetlb;
+        } else if (arg == "--account-stats") {
+            account_stats = true;
+        } else if (parseIntOption(arg, "--rate-limit", rate_limit) ||
+                   parseIntOption(arg, "--rate-burst", rate_burst) ||
+                   parseIntOption(arg, "--dedup-ms", dedup_ms, 0) ||
+                   parseIntOption(arg, "--accounts", accounts) ||
+                   parseIntOption(arg, "--spam-rate", spam_rate, 0)) {
+            continue;
+        } else if (arg == "--simulate") {
+            simulate = true;
+        } else if (arg == "--parallel-sim") {
+            parallel_sim = true;
+        } else if (parseIntOption(arg, "--lookahead-ms", lookahead_ms)) {
+            continue;
+        } else if (parseStringOption(arg, "--scenario", scenario_path)) {
+            continue;
+        } else if (arg == "--ndjson") {
+            ndjson = true;
+        } else if (parseStringOption(arg, "--ndjson", ndjson_path)) {
+            ndjson = true;
+        } else if (parseStringOption(arg, "--summary-json", summary_json_path) ||
+                   parseStringOption(arg, "--summary-csv", summary_csv_path) ||
+                   parseStringOption(arg, "--event-log", event_log_path) ||
+                   parseStringOption(arg, "--sketch-out", sketch_path) ||
+                   parseStringOption(arg, "--state-file", state_path)) {
+            continue;
+        } else if (arg == "--full-status") {
+            full_status = true;
+        } else if (arg == "--dashboard") {
+            dashboard_fps = 10;
+        } else if (arg == "--no-warmup") {
+            forecast_warmup = false;
+        } else if (arg == "--plan") {
+            plan = true;
+        } else if (arg == "--batch-report") {
+            batch_report = true;
+        } else if (arg == "--tick-report") {
+            tick_report = true;
+        } else if (parseIntOption(arg, "--replications", replications) ||
+                   parseIntOption(arg, "--slo-p99", slo_p99) ||
+                   parseIntOption(arg, "--max-instances", max_instances) ||
+                   parseIntOption(arg, "--threads", threads) ||
+                   parseIntOption(arg, "--forecast-bucket-ms", forecast_bucket_ms) ||
+                   parseIntOption(arg, "--forecast-horizon", forecast_horizon) ||
+                   parseIntOption(arg, "--dashboard", dashboard_fps) ||
+                   parseIntOption(arg, "--checkpoint-interval", checkpoint_interval) ||
+                   parseSimulationOption(arg, sim_config)) {
+            regions_given = regions_given || arg.rfind("--regions=", 0) == 0;
+            continue;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: " << argv[0] << " [--prefault]"
+                      << " [--bench|--bench-json [--bench-parties=N] [--bench-producers=N] [--bench-instances=N]]"
+                      << " [--predict [--replications=N]]"
+                      << " [--plan [--slo-p99=S] [--max-instances=N] [--replications=N] [--threads=N]]"
+                      << " [--batch-report] [--simulate] [--parallel-sim [--lookahead-ms=MS]] [--scenario=FILE]"
+                      << " [--instances=N] [--tanks=N] [--healers=N] [--dps=N] [--min-time=S] [--max-time=S]"
+                      << " [--interval-ms=MS] [--runtime=S] [--role-mix=T,H,D] [--seed=N]"
+                      << " [--regions=N] [--match-window-ms=MS] [--match-budget-us=US] [--match-max-hold=S]"
+                      << " [--tick-ms=MS] [--tick-report]"
+                      << " [--forecast-bucket-ms=MS] [--forecast-horizon=S] [--no-warmup]"
+                      << " [--dashboard[=FPS]] [--full-status] [--ndjson[=PATH]]"
+                      << " [--summary-json=PATH] [--summary-csv=PATH] [--event-log=PATH] [--sketch-out=PATH]"
+                      << " [--rate-limit=PER_MIN [--rate-burst=N] [--dedup-ms=MS] [--accounts=N] [--spam-rate=N]] [--account-stats]"
+                      << " [--hugepages[=thp|hugetlb]] [--queue-timeout=S]"
+                      << " [--state-file=PATH [--checkpoint-interval=S]]" << std::endl;
+            return 1;
+        }
+    }
+    
+    if (sim_config.max_time < sim_config.min_time) {
+        std::cerr << "--max-time must be greater than or equal to --min-time." << std::endl;
+        return 1;
+    }
+    if (sim_config.tick_ms > 0 && sim_config.match_window_ms > 0) {
+        std::cerr << "--tick-ms and --match-window-ms are alternative matching schedules; pick one." << std::endl;
+        return 1;
+    }
     
-    n = getValidatedInteger("Enter number of dungeon instances (n): ", true);
+    std::shared_ptr<ScenarioSchedule> scenario;
+    if (!scenario_path.empty()) {
+        scenario = std::make_shared<ScenarioSchedule>();
+        if (!scenario->load(scenario_path)) {
+            return 1;
+        }
+        sim_config.scenario = scenario;
+    }
     
-    t = getValidatedInteger("Enter initial number of tank players (t): ");
+    if (predict) {
+        if (scenario) {
+            std::cerr << "--predict models a constant arrival rate and does not accept --scenario." << std::endl;
+            return 1;
+        }
+        runPredictionComparison(sim_config, replications);
+        return 0;
+    }
     
-    h = getValidatedInteger("Enter initial number of healer players (h): ");
+    if (simulate) {
+        return runSingleSimulation(sim_config, event_log_path, sketch_path) ? 0 : 1;
+    }
+    
+    if (parallel_sim) {
+        if (sim_config.match_window_ms > 0 || sim_config.tick_ms > 0) {
+            std::cerr << "--parallel-sim runs the event-driven greedy matcher and does not accept --match-window-ms or --tick-ms."
+                      << std::endl;
+            return 1;
+        }
+        // Partitions own whole regions, so without --regions there is one
+        // region per thread.
+        if (!regions_given) {
+            sim_config.regions = std::min(threads, 64);
+        }
+        return runParallelSimulation(sim_config, std::min(threads, 64), std::min(replications, 5), lookahead_ms,
+                                     sketch_path) ? 0 : 1;
+    }
+    
+    if (batch_report) {
+        runBatchWindowReport(sim_config, std::min(replications, 5));
+        return 0;
+    }
+    
+    if (tick_report) {
+        runTickReport(sim_config, std::min(replications, 5));
+        return 0;
+    }
+    
+    if (plan) {
+        if (scenario && std::any_of(scenario->events.begin(), scenario->events.end(), [](const ScenarioEvent& event) {
+                return event.kind == ScenarioEvent::Capacity;
+            })) {
+            std::cerr << "--plan chooses the instance count itself; remove 'capacity' lines from the scenario." << std::endl;
+            return 1;
+        }
+        runCapacityPlanner(sim_config, slo_p99, max_instances, replications, threads);
+        return 0;
+    }
+    
+    std::unique_ptr<EventWriter> event_writer;
+    if (ndjson) {
+        int fd = STDOUT_FILENO;
+        if (!ndjson_path.empty()) {
+            fd = ::open(ndjson_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0) {
+                std::cerr << "Cannot open " << ndjson_path << ": " << std::strerror(errno) << std::endl;
+                return 1;
+            }
+        } else {
+            // Keep stdout clean for the event stream; prompts and reports go to stderr.
+            std::cout.rdbuf(std::cerr.rdbuf());
+        }
+        event_writer = std::make_unique<EventWriter>(fd);
+    }
     
-    d = getValidatedInteger("Enter initial number of DPS players (d): ");
+    if (benchmark) {
+        DungeonManager manager(bench_instances, 0, 0, 0, nullptr, page_mode);
+        manager.setEventWriter(event_writer.get());
+        if (prefault) {
+            manager.prefaultInstanceState();
+        }
+        manager.runMatchingBenchmark(bench_parties, bench_producers, bench_json);
+        return 0;
+    }
     
-    t1 = getValidatedInteger("Enter minimum dungeon time (t1): ");
+    std::cout << "=== MMORPG Dungeon LFG Queue System ===" << std::endl;
     
-    t2 = getValidatedIntegerWithRange("Enter maximum dungeon time (t2): ", t1);
+    std::unique_ptr<QueueStore> restored;
+    struct stat state_info;
+    if (!state_path.empty() && ::stat(state_path.c_str(), &state_info) == 0) {
+        QueueStore::RestoreStats restore_stats;
+        std::string error;
+        auto restore_start = std::chrono::steady_clock::now();
+        restored = QueueStore::restore(state_path, restore_stats, error);
+        double restore_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - restore_start).count();
+        if (restored == nullptr) {
+            std::cerr << "Cannot restore " << state_path << ": " << error << std::endl;
+            return 1;
+        }
+        const QueueStore::Image& image = restored->image();
+        n = static_cast<int>(image.instance_count);
+        t = image.initial_players[0];
+        h = image.initial_players[1];
+        d = image.initial_players[2];
+        t1 = image.min_time;
+        t2 = image.max_time;
+        std::cout << "Restored " << state_path << " in " << std::fixed << std::setprecision(2) << restore_ms
+                  << " ms (generation " << restore_stats.generation << ", " << restore_stats.replayed
+                  << " journal records replayed";
+        if (restore_stats.dropped_bytes > 0) {
+            std::cout << ", " << restore_stats.dropped_bytes << " bytes of torn journal tail dropped";
+        }
+        std::cout << ")" << std::endl;
+        std::cout << "Queued: " << image.queued[0] << " tanks, " << image.queued[1] << " healers, "
+                  << image.queued[2] << " DPS | Parties formed so far: " << image.parties_formed << std::endl;
+    } else {
+        n = getValidatedInteger("Enter number of dungeon instances (n): ", true);
+        
+        t = getValidatedInteger("Enter initial number of tank players (t): ");
+        
+        h = getValidatedInteger("Enter initial number of healer players (h): ");
+        
+        d = getValidatedInteger("Enter initial number of DPS players (d): ");
+        
+        t1 = getValidatedInteger("Enter minimum dungeon time (t1): ");
+        
+        t2 = getValidatedIntegerWithRange("Enter maximum dungeon time (t2): ", t1);
+    }
     
     std::cout << "\nInitializing dungeon system with:" << std::endl;
     std::cout << "Instances: " << n << " | Initial Tanks: " << t 
               << " | Initial Healers: " << h << " | Initial DPS: " << d << std::endl;
     std::cout << "Dungeon time range: " << t1 << "s to " << t2 << "s" << std::endl;
-    std::cout << "Producer will add new players every 3 seconds for 30 seconds." << std::endl;
+    if (scenario) {
+        std::cout << "Scenario " << scenario_path << " will run for " << scenario->duration << " seconds." << std::endl;
+    } else {
+        std::cout << "Producer will add new players every 3 seconds for 30 seconds." << std::endl;
+    }
     
-    DungeonManager manager(n, t, h, d);
+    DungeonManager manager(n, t, h, d, std::move(restored), page_mode);
+    if (manager.resumedFromState()) {
+        std::string violation;
+        if (!manager.checkInvariants(violation)) {
+            std::cerr << "Restored state is inconsistent: " << violation << std::endl;
+            return 1;
+        }
+        manager.setCheckpointInterval(checkpoint_interval);
+    } else if (!state_path.empty()) {
+        std::string error;
+        if (!manager.createStateFile(state_path, t1, t2, checkpoint_interval, error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        std::cout << "Queue state will be kept in " << state_path << std::endl;
+    }
+    manager.setFullStatus(full_status);
+    manager.setEventWriter(event_writer.get());
+    manager.configureForecast(std::chrono::milliseconds(forecast_bucket_ms),
+                              std::chrono::seconds(forecast_horizon), forecast_warmup);
+    manager.setDashboard(dashboard_fps);
+    manager.setScenario(scenario.get());
+    manager.setQueueTimeout(queue_timeout);
+    ColumnarEventLog event_log;
+    if (!event_log_path.empty()) {
+        if (!event_log.open(event_log_path)) {
+            std::cerr << "Cannot open " << event_log_path << ": " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        manager.setEventLog(&event_log);
+    }
+    std::unique_ptr<IngestionGuard> ingestion_guard;
+    if (rate_limit > 0) {
+        ingestion_guard = std::make_unique<IngestionGuard>(rate_limit, rate_burst, dedup_ms, accounts);
+        manager.setIngestionGuard(ingestion_guard.get(), accounts, spam_rate);
+    }
+    std::unique_ptr<AccountAnalytics> account_analytics;
+    if (account_stats) {
+        account_analytics = std::make_unique<AccountAnalytics>();
+        manager.setAccountAnalytics(account_analytics.get(), accounts, spam_rate);
+    }
+    if (prefault) {
+        manager.prefaultInstanceState();
+    }
     manager.startInstances(t1, t2);
+    if (!event_log_path.empty()) {
+        if (!event_log.close()) {
+            std::cerr << "Failed to write " << event_log_path << std::endl;
+            return 1;
+        }
+        std::cout << "Event log: " << event_log.rowsWritten() << " rows written to " << event_log_path << std::endl;
+    }
+    if (!sketch_path.empty() && !writeSketchFile(sketch_path, manager.sketches())) {
+        return 1;
+    }
     
+    if (!manager.exportSummary(summary_json_path, summary_csv_path)) {
+        return 1;
+    }
     return 0;
 }
\ No newline at end of file
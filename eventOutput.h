@@ -0,0 +1,321 @@
+#ifndef EVENT_OUTPUT_H
+#define EVENT_OUTPUT_H
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "columnarLog.h"
+#include "ddSketch.h"
+
+/*
+ * Outputs of a real-time run: NDJSON event records and the background writer
+ * that streams them, atomic file replacement for summaries and sketch files,
+ * and the appender for the columnar event log that eventQuery reads.
+ */
+
+class EventRecord {
+private:
+    // Records are built on the stack and only move to the heap if one
+    // outgrows inline_buffer.
+    char inline_buffer[256];
+    std::string spilled;
+    char* buffer{inline_buffer};
+    size_t capacity{sizeof(inline_buffer)};
+    size_t length{0};
+    
+    void reserve(size_t extra) {
+        if (length + extra <= capacity) {
+            return;
+        }
+        capacity = std::max(capacity * 2, length + extra);
+        if (buffer == inline_buffer) {
+            spilled.assign(inline_buffer, length);
+        }
+        spilled.resize(capacity);
+        buffer = spilled.data();
+    }
+    
+    void append(const char* text) {
+        size_t size = std::strlen(text);
+        reserve(size);
+        std::memcpy(buffer + length, text, size);
+        length += size;
+    }
+    
+    void appendNumber(long long value) {
+        reserve(std::numeric_limits<long long>::digits10 + 2);
+        length = std::to_chars(buffer + length, buffer + capacity, value).ptr - buffer;
+    }
+
+public:
+    EventRecord(const char* type, long long timestamp_us) {
+        append("{\"ts_us\":");
+        appendNumber(timestamp_us);
+        append(",\"event\":\"");
+        append(type);
+        append("\"");
+    }
+    
+    EventRecord(const EventRecord&) = delete;
+    EventRecord& operator=(const EventRecord&) = delete;
+    
+    // Field names are trusted literals, so nothing needs escaping.
+    EventRecord& field(const char* name, long long value) {
+        append(",\"");
+        append(name);
+        append("\":");
+        appendNumber(value);
+        return *this;
+    }
+    
+    const char* finish() {
+        append("}\n");
+        return buffer;
+    }
+    
+    size_t size() const {
+        return length;
+    }
+    
+    static long long now() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+};
+
+class EventWriter {
+private:
+    static constexpr size_t flush_bytes = 1 << 20;
+    static constexpr size_t max_pending_bytes = 64 << 20;
+    
+    int fd;
+    std::mutex mtx;
+    std::condition_variable wake_writer;
+    std::condition_variable space_available;
+    std::string pending;
+    bool stopping{false};
+    bool failed{false};
+    unsigned long long events_written{0};
+    std::thread writer_thread;
+    
+    void run() {
+        std::string writing;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake_writer.wait_for(lock, std::chrono::milliseconds(50), [this]() {
+                    return stopping || pending.size() >= flush_bytes;
+                });
+                writing.swap(pending);
+                space_available.notify_all();
+                if (writing.empty() && stopping) {
+                    return;
+                }
+            }
+            
+            size_t offset = 0;
+            while (offset < writing.size() && !failed) {
+                ssize_t written = ::write(fd, writing.data() + offset, writing.size() - offset);
+                if (written < 0 && errno != EINTR) {
+                    std::cerr << "Event output failed: " << std::strerror(errno) << std::endl;
+                    failed = true;
+                } else if (written > 0) {
+                    offset += written;
+                }
+            }
+            writing.clear();
+        }
+    }
+
+public:
+    explicit EventWriter(int output_fd) : fd(output_fd) {
+        pending.reserve(flush_bytes * 2);
+        writer_thread = std::thread(&EventWriter::run, this);
+    }
+    
+    ~EventWriter() {
+        stop();
+    }
+    
+    EventWriter(const EventWriter&) = delete;
+    EventWriter& operator=(const EventWriter&) = delete;
+    
+    void write(EventRecord& record) {
+        const char* line = record.finish();
+        std::unique_lock<std::mutex> lock(mtx);
+        space_available.wait(lock, [this]() { return pending.size() < max_pending_bytes || stopping; });
+        pending.append(line, record.size());
+        events_written++;
+        if (pending.size() >= flush_bytes) {
+            wake_writer.notify_one();
+        }
+    }
+    
+    // Flushes everything written so far and stops the writer thread.
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stopping = true;
+            wake_writer.notify_one();
+        }
+        if (writer_thread.joinable()) {
+            writer_thread.join();
+        }
+    }
+    
+    unsigned long long eventsWritten() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return events_written;
+    }
+};
+
+// Writes to a temporary file next to path and renames it into place, so
+// readers never see a partially written file.
+inline bool writeFileAtomically(const std::string& path, const std::string& contents) {
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write(contents.data(), contents.size());
+        out.flush();
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(temp_path.c_str(), path.c_str()) == 0;
+}
+
+// Saves sketches in the ddSketch.h file format for sketchMerge to combine.
+inline bool writeSketchFile(const std::string& path, const NamedSketches& sketches) {
+    if (!writeFileAtomically(path, serializeSketches(sketches))) {
+        std::cerr << "Failed to write sketches to " << path << std::endl;
+        return false;
+    }
+    std::cout << "Sketches: " << sketches.size() << " written to " << path << std::endl;
+    return true;
+}
+
+// Appends rows to a columnar event log (see columnarLog.h for the layout).
+// Rows are staged column by column and written one block at a time. Not
+// thread-safe: the manager only appends under its lock.
+class ColumnarEventLog {
+private:
+    int fd{-1};
+    bool failed{false};
+    unsigned long long rows_written{0};
+    std::vector<int64_t> timestamps;
+    std::vector<float> waits;
+    std::vector<uint8_t> kinds;
+    std::vector<uint8_t> roles;
+    std::vector<uint16_t> regions;
+    std::string block;
+    
+    void writeAll(const char* data, size_t size) {
+        while (size > 0 && !failed) {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                failed = true;
+                break;
+            }
+            data += written;
+            size -= static_cast<size_t>(written);
+        }
+    }
+    
+    void flushBlock() {
+        uint32_t rows = static_cast<uint32_t>(timestamps.size());
+        if (rows == 0) {
+            return;
+        }
+        ColumnarBlockHeader header;
+        columnarLayout(header, rows);
+        auto range = std::minmax_element(timestamps.begin(), timestamps.end());
+        header.min_timestamp_us = *range.first;
+        header.max_timestamp_us = *range.second;
+        
+        block.assign(header.block_bytes, '\0');
+        std::memcpy(block.data(), &header, sizeof(header));
+        const void* columns[COLUMN_COUNT]{timestamps.data(), waits.data(), kinds.data(), roles.data(), regions.data()};
+        for (int column = 0; column < COLUMN_COUNT; column++) {
+            std::memcpy(block.data() + header.column_offset[column], columns[column],
+                        static_cast<size_t>(columnar_widths[column]) * rows);
+        }
+        writeAll(block.data(), block.size());
+        rows_written += rows;
+        timestamps.clear();
+        waits.clear();
+        kinds.clear();
+        roles.clear();
+        regions.clear();
+    }
+
+public:
+    ~ColumnarEventLog() {
+        close();
+    }
+    
+    bool open(const std::string& path) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        ColumnarFileHeader header{};
+        std::memcpy(header.magic, columnar_magic, sizeof(header.magic));
+        header.version = columnar_version;
+        header.block_rows = columnar_block_rows;
+        writeAll(reinterpret_cast<const char*>(&header), sizeof(header));
+        return !failed;
+    }
+    
+    void append(int64_t timestamp_us, ColumnarKind kind, int role, int region, float wait_ms) {
+        if (fd < 0) {
+            return;
+        }
+        timestamps.push_back(timestamp_us);
+        waits.push_back(wait_ms);
+        kinds.push_back(kind);
+        roles.push_back(static_cast<uint8_t>(role));
+        regions.push_back(static_cast<uint16_t>(region));
+        if (timestamps.size() == columnar_block_rows) {
+            flushBlock();
+        }
+    }
+    
+    // Writes the partial block and closes the file; false if any write failed.
+    bool close() {
+        if (fd < 0) {
+            return !failed;
+        }
+        flushBlock();
+        ::close(fd);
+        fd = -1;
+        return !failed;
+    }
+    
+    unsigned long long rowsWritten() const {
+        return rows_written;
+    }
+};
+
+#endif
@@ -0,0 +1,437 @@
+#include "columnarLog.h"
+#include "toolOptions.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Rows are filtered 32 at a time with GCC vector extensions; every predicate
+// turns into one compare per column chunk and a byte mask.
+constexpr size_t lane_count = 32;
+using ByteLanes = uint8_t __attribute__((vector_size(lane_count)));
+using MaskLanes = int8_t __attribute__((vector_size(lane_count)));
+using RegionLanes = uint16_t __attribute__((vector_size(lane_count * 2)));
+using TimeLanes = int64_t __attribute__((vector_size(lane_count * 8)));
+
+enum GroupBy { GROUP_NONE, GROUP_ROLE, GROUP_REGION, GROUP_HOUR };
+
+struct Query {
+    int kind{COLUMNAR_MATCHED};
+    int role{-1};
+    int region{-1};
+    bool has_from{false};
+    bool has_to{false};
+    std::string from_text;
+    std::string to_text;
+    int64_t from_us{0};
+    int64_t to_us{0};
+    GroupBy group_by{GROUP_NONE};
+    int threads{static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))};
+};
+
+struct ScanTotals {
+    uint64_t blocks_scanned{0};
+    uint64_t rows_scanned{0};
+};
+
+// Per-thread partial result: the waits of matching rows, bucketed by group.
+struct PartialResult {
+    std::vector<std::vector<float>> groups;
+    ScanTotals totals;
+};
+
+bool parseRole(const std::string& text, int& role) {
+    static const char* names[3]{"tank", "healer", "dps"};
+    for (int i = 0; i < 3; i++) {
+        if (text == names[i]) {
+            role = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseKind(const std::string& text, int& kind) {
+    static const char* names[3]{"matched", "expired", "cancelled"};
+    for (int i = 0; i < 3; i++) {
+        if (text == names[i]) {
+            kind = i;
+            return true;
+        }
+    }
+    if (text == "all") {
+        kind = -1;
+        return true;
+    }
+    return false;
+}
+
+// HH:MM[:SS] is a UTC time of day on the day the log starts; "24:00" is the
+// following midnight. Plain numbers are Unix seconds.
+bool parseTime(const std::string& text, int64_t day_start_us, int64_t& out_us) {
+    int hours = 0, minutes = 0, seconds = 0;
+    if (text.find(':') != std::string::npos) {
+        // consumed ends after the minutes or, if present, the seconds, so
+        // trailing text after either is rejected.
+        int consumed = -1;
+        std::sscanf(text.c_str(), "%d:%d%n:%d%n", &hours, &minutes, &consumed, &seconds, &consumed);
+        if (consumed != static_cast<int>(text.size()) || hours < 0 || minutes < 0 || minutes > 59 || seconds < 0 ||
+            seconds > 59) {
+            return false;
+        }
+        out_us = day_start_us + ((hours * 60LL + minutes) * 60 + seconds) * 1000000LL;
+        return true;
+    }
+    char* end = nullptr;
+    long long unix_seconds = std::strtoll(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0') {
+        return false;
+    }
+    out_us = unix_seconds * 1000000LL;
+    return true;
+}
+
+void scanBlock(const ColumnarBlockHeader& header, const Query& query, int64_t day_start_us,
+               std::vector<uint8_t>& keep, PartialResult& partial) {
+    uint32_t rows = header.rows;
+    size_t chunks = (rows + lane_count - 1) / lane_count;
+    const char* block = reinterpret_cast<const char*>(&header);
+    std::fill(keep.begin(), keep.begin() + chunks * lane_count, 0xff);
+
+    // Only the columns a predicate needs are read. Loads may run past the
+    // last row into the column's padding or the next column, and the region
+    // column is last in the block, so a load never leaves the mapping; lanes
+    // past the last row are cleared below.
+    if (query.kind >= 0) {
+        const uint8_t* kinds = reinterpret_cast<const uint8_t*>(block + header.column_offset[COLUMN_KIND]);
+        ByteLanes wanted = ByteLanes{} + static_cast<uint8_t>(query.kind);
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            ByteLanes values, mask;
+            std::memcpy(&values, kinds + chunk * lane_count, sizeof(values));
+            std::memcpy(&mask, keep.data() + chunk * lane_count, sizeof(mask));
+            mask &= reinterpret_cast<ByteLanes>(values == wanted);
+            std::memcpy(keep.data() + chunk * lane_count, &mask, sizeof(mask));
+        }
+    }
+    if (query.role >= 0) {
+        const uint8_t* roles = reinterpret_cast<const uint8_t*>(block + header.column_offset[COLUMN_ROLE]);
+        ByteLanes wanted = ByteLanes{} + static_cast<uint8_t>(query.role);
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            ByteLanes values, mask;
+            std::memcpy(&values, roles + chunk * lane_count, sizeof(values));
+            std::memcpy(&mask, keep.data() + chunk * lane_count, sizeof(mask));
+            mask &= reinterpret_cast<ByteLanes>(values == wanted);
+            std::memcpy(keep.data() + chunk * lane_count, &mask, sizeof(mask));
+        }
+    }
+    if (query.region >= 0) {
+        const char* regions = block + header.column_offset[COLUMN_REGION];
+        RegionLanes wanted = RegionLanes{} + static_cast<uint16_t>(query.region);
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            RegionLanes values;
+            ByteLanes mask;
+            std::memcpy(&values, regions + chunk * sizeof(values), sizeof(values));
+            std::memcpy(&mask, keep.data() + chunk * lane_count, sizeof(mask));
+            mask &= reinterpret_cast<ByteLanes>(__builtin_convertvector(values == wanted, MaskLanes));
+            std::memcpy(keep.data() + chunk * lane_count, &mask, sizeof(mask));
+        }
+    }
+    bool fully_inside = (!query.has_from || header.min_timestamp_us >= query.from_us) &&
+                        (!query.has_to || header.max_timestamp_us < query.to_us);
+    if (!fully_inside) {
+        const char* timestamps = block + header.column_offset[COLUMN_TIMESTAMP_US];
+        TimeLanes from = TimeLanes{} + (query.has_from ? query.from_us : INT64_MIN);
+        TimeLanes to = TimeLanes{} + (query.has_to ? query.to_us : INT64_MAX);
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            TimeLanes values;
+            ByteLanes mask;
+            std::memcpy(&values, timestamps + chunk * sizeof(values), sizeof(values));
+            std::memcpy(&mask, keep.data() + chunk * lane_count, sizeof(mask));
+            mask &= reinterpret_cast<ByteLanes>(__builtin_convertvector((values >= from) & (values < to), MaskLanes));
+            std::memcpy(keep.data() + chunk * lane_count, &mask, sizeof(mask));
+        }
+    }
+    std::fill(keep.begin() + rows, keep.begin() + chunks * lane_count, 0);
+
+    const float* waits = reinterpret_cast<const float*>(block + header.column_offset[COLUMN_WAIT_MS]);
+    const uint8_t* roles = reinterpret_cast<const uint8_t*>(block + header.column_offset[COLUMN_ROLE]);
+    const uint16_t* regions = reinterpret_cast<const uint16_t*>(block + header.column_offset[COLUMN_REGION]);
+    const int64_t* timestamps = reinterpret_cast<const int64_t*>(block + header.column_offset[COLUMN_TIMESTAMP_US]);
+    for (size_t start = 0; start < rows; start += 8) {
+        uint64_t word;
+        std::memcpy(&word, keep.data() + start, sizeof(word));
+        if (word == 0) {
+            continue;
+        }
+        for (size_t row = start; row < std::min<size_t>(start + 8, rows); row++) {
+            if (!keep[row]) {
+                continue;
+            }
+            size_t group = 0;
+            switch (query.group_by) {
+                case GROUP_NONE: break;
+                case GROUP_ROLE: group = roles[row]; break;
+                case GROUP_REGION: group = regions[row]; break;
+                case GROUP_HOUR:
+                    group = static_cast<size_t>(std::max<int64_t>(0, timestamps[row] - day_start_us) / 3600000000LL);
+                    break;
+            }
+            if (group >= partial.groups.size()) {
+                partial.groups.resize(group + 1);
+            }
+            partial.groups[group].push_back(waits[row]);
+        }
+    }
+    partial.totals.blocks_scanned++;
+    partial.totals.rows_scanned += rows;
+}
+
+std::string groupLabel(GroupBy group_by, size_t group) {
+    static const char* role_names[3]{"tank", "healer", "dps"};
+    switch (group_by) {
+        case GROUP_NONE: return "all";
+        case GROUP_ROLE: return group < 3 ? role_names[group] : std::to_string(group);
+        case GROUP_REGION: return "region " + std::to_string(group);
+        case GROUP_HOUR: {
+            // Hours after the log's first day carry a "+Nd" day offset.
+            char label[40];
+            size_t day = group / 24;
+            size_t hour = group % 24;
+            if (day == 0) {
+                std::snprintf(label, sizeof(label), "%02zu:00-%02zu:00", hour, hour + 1);
+            } else {
+                std::snprintf(label, sizeof(label), "+%zud %02zu:00-%02zu:00", day, hour, hour + 1);
+            }
+            return label;
+        }
+    }
+    return "";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " LOG [--kind=matched|expired|cancelled|all] [--role=tank|healer|dps]"
+                  << " [--region=N] [--from=HH:MM] [--to=HH:MM] [--group-by=role|region|hour] [--threads=N]"
+                  << std::endl;
+        return 1;
+    }
+    std::string path = argv[1];
+    Query query;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        if (parseOption(arg, "--kind", value)) {
+            if (!parseKind(value, query.kind)) {
+                std::cerr << "Unknown kind: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--role", value)) {
+            if (!parseRole(value, query.role)) {
+                std::cerr << "Unknown role: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--region", value)) {
+            long long region = 0;
+            if (!parseCount(value, 0, 65535, region)) {
+                std::cerr << "--region must be between 0 and 65535." << std::endl;
+                return 1;
+            }
+            query.region = static_cast<int>(region);
+        } else if (parseOption(arg, "--from", query.from_text)) {
+            query.has_from = true;
+        } else if (parseOption(arg, "--to", query.to_text)) {
+            query.has_to = true;
+        } else if (parseOption(arg, "--group-by", value)) {
+            if (value == "role") {
+                query.group_by = GROUP_ROLE;
+            } else if (value == "region") {
+                query.group_by = GROUP_REGION;
+            } else if (value == "hour") {
+                query.group_by = GROUP_HOUR;
+            } else {
+                std::cerr << "Unknown grouping: " << value << std::endl;
+                return 1;
+            }
+        } else if (parseOption(arg, "--threads", value)) {
+            long long threads = 0;
+            if (!parseCount(value, 1, INT_MAX, threads)) {
+                std::cerr << "--threads must be at least 1." << std::endl;
+                return 1;
+            }
+            query.threads = static_cast<int>(threads);
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || ::fstat(fd, &info) != 0) {
+        std::cerr << "Cannot open " << path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    size_t file_size = static_cast<size_t>(info.st_size);
+    if (file_size < sizeof(ColumnarFileHeader)) {
+        std::cerr << path << " is not a columnar event log." << std::endl;
+        return 1;
+    }
+    void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Cannot map " << path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    const char* base = static_cast<const char*>(mapping);
+    ColumnarFileHeader file_header;
+    std::memcpy(&file_header, base, sizeof(file_header));
+    if (std::memcmp(file_header.magic, columnar_magic, sizeof(columnar_magic)) != 0 ||
+        file_header.version != columnar_version) {
+        std::cerr << path << " is not a version " << columnar_version << " columnar event log." << std::endl;
+        return 1;
+    }
+    // Scan buffers are sized for columnar_block_rows, the only block size the
+    // producer writes.
+    if (file_header.block_rows != columnar_block_rows) {
+        std::cerr << path << " has " << file_header.block_rows << "-row blocks; expected "
+                  << columnar_block_rows << "." << std::endl;
+        return 1;
+    }
+
+    std::vector<const ColumnarBlockHeader*> blocks;
+    uint64_t total_rows = 0;
+    int64_t first_us = INT64_MAX;
+    for (size_t offset = sizeof(ColumnarFileHeader); offset + sizeof(ColumnarBlockHeader) <= file_size;) {
+        const ColumnarBlockHeader* header = reinterpret_cast<const ColumnarBlockHeader*>(base + offset);
+        ColumnarBlockHeader expected;
+        columnarLayout(expected, header->rows);
+        if (header->rows == 0 || header->rows > file_header.block_rows ||
+            header->block_bytes != expected.block_bytes || offset + header->block_bytes > file_size) {
+            break;
+        }
+        blocks.push_back(header);
+        total_rows += header->rows;
+        first_us = std::min(first_us, header->min_timestamp_us);
+        offset += header->block_bytes;
+    }
+    int64_t day_start_us = blocks.empty() ? 0 : first_us - first_us % 86400000000LL;
+
+    if ((query.has_from && !parseTime(query.from_text, day_start_us, query.from_us)) ||
+        (query.has_to && !parseTime(query.to_text, day_start_us, query.to_us))) {
+        std::cerr << "Times are HH:MM[:SS] (UTC, on the log's first day) or Unix seconds." << std::endl;
+        return 1;
+    }
+
+    // Zone maps: a block whose time range misses the filter is never touched.
+    std::vector<const ColumnarBlockHeader*> candidates;
+    for (const ColumnarBlockHeader* header : blocks) {
+        if ((query.has_from && header->max_timestamp_us < query.from_us) ||
+            (query.has_to && header->min_timestamp_us >= query.to_us)) {
+            continue;
+        }
+        candidates.push_back(header);
+    }
+
+    int thread_count = std::max(1, std::min<int>(query.threads, static_cast<int>(candidates.size())));
+    std::vector<PartialResult> partials(thread_count);
+    std::atomic<size_t> next_block{0};
+    auto worker = [&](int index) {
+        std::vector<uint8_t> keep(columnar_block_rows + lane_count);
+        PartialResult& partial = partials[index];
+        for (size_t block = next_block.fetch_add(1); block < candidates.size(); block = next_block.fetch_add(1)) {
+            scanBlock(*candidates[block], query, day_start_us, keep, partial);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int t = 1; t < thread_count; t++) {
+        workers.emplace_back(worker, t);
+    }
+    worker(0);
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    ScanTotals totals;
+    std::vector<std::vector<float>> groups;
+    for (auto& partial : partials) {
+        totals.blocks_scanned += partial.totals.blocks_scanned;
+        totals.rows_scanned += partial.totals.rows_scanned;
+        if (partial.groups.size() > groups.size()) {
+            groups.resize(partial.groups.size());
+        }
+        for (size_t group = 0; group < partial.groups.size(); group++) {
+            groups[group].insert(groups[group].end(), partial.groups[group].begin(), partial.groups[group].end());
+            std::vector<float>().swap(partial.groups[group]);
+        }
+    }
+
+    // Percentiles are asked for in increasing order, so each selection only
+    // has to partition what lies above the previous one.
+    auto percentile = [](std::vector<float>& values, size_t& floor, double fraction) {
+        size_t rank = static_cast<size_t>(std::ceil(fraction * values.size())) - 1;
+        std::nth_element(values.begin() + floor, values.begin() + rank, values.end());
+        floor = rank;
+        return values[rank] / 1000.0;
+    };
+
+    std::time_t day_seconds = static_cast<std::time_t>(day_start_us / 1000000);
+    char day[16];
+    std::strftime(day, sizeof(day), "%Y-%m-%d", std::gmtime(&day_seconds));
+    std::cout << "Log: " << path << " | " << total_rows << " rows in " << blocks.size() << " blocks | first day "
+              << day << " (UTC)" << std::endl;
+    std::cout << "Blocks scanned: " << totals.blocks_scanned << " of " << blocks.size() << " ("
+              << blocks.size() - candidates.size() << " pruned by time) | Rows scanned: " << totals.rows_scanned
+              << std::endl;
+    std::cout << std::left << std::setw(18) << "Group" << std::right << std::setw(12) << "Players"
+              << std::setw(12) << "Mean wait" << std::setw(10) << "p50" << std::setw(10) << "p95"
+              << std::setw(10) << "p99" << std::setw(10) << "Max" << std::endl;
+    std::cout << std::string(82, '-') << std::endl;
+    uint64_t matched = 0;
+    for (size_t group = 0; group < groups.size(); group++) {
+        std::vector<float>& values = groups[group];
+        if (values.empty()) {
+            continue;
+        }
+        matched += values.size();
+        double total = 0.0;
+        for (float value : values) {
+            total += value;
+        }
+        size_t floor = 0;
+        double p50 = percentile(values, floor, 0.50);
+        double p95 = percentile(values, floor, 0.95);
+        double p99 = percentile(values, floor, 0.99);
+        double highest = *std::max_element(values.begin() + floor, values.end()) / 1000.0;
+        std::cout << std::left << std::setw(18) << groupLabel(query.group_by, group) << std::right
+                  << std::setw(12) << values.size() << std::fixed << std::setprecision(2)
+                  << std::setw(11) << total / values.size() / 1000.0 << "s" << std::setw(9) << p50 << "s"
+                  << std::setw(9) << p95 << "s" << std::setw(9) << p99 << "s" << std::setw(9) << highest << "s"
+                  << std::endl;
+    }
+    if (matched == 0) {
+        std::cout << "No rows match." << std::endl;
+    }
+    std::cout << std::string(82, '-') << std::endl;
+    std::cout << "Query took " << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count()
+              << " ms on " << thread_count << " thread(s)" << std::endl;
+    ::munmap(mapping, file_size);
+    return 0;
+}
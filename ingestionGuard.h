@@ -0,0 +1,501 @@
+#ifndef INGESTION_GUARD_H
+#define INGESTION_GUARD_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * Per-account controls on the enqueue path: admission (rate limits and
+ * duplicate suppression) and approximate account statistics.
+ */
+
+// Per-account admission control at ingestion: a token bucket per account plus
+// suppression of repeat enqueues inside a short window. State lives in a
+// sharded, bucketized hash table; each shard is guarded by a spinlock held while
+// one account is looked up. Idle accounts are evicted by a sweeper thread. A
+// new account only takes over a slot whose bucket has refilled completely, in
+// its own bucket or else in a second one picked by another hash. If both are
+// full of active accounts the request is refused as rate limited and counted
+// as table_full; the table is sized so that this stays rare.
+class IngestionGuard {
+public:
+    enum Verdict { Admitted, RateLimited, Duplicate };
+
+private:
+    static constexpr int shard_bits = 6;
+    static constexpr int bucket_slots = 8;
+    
+    // Accounts are stored contiguously so a lookup compares one cache line
+    // without data-dependent branches.
+    struct alignas(64) Bucket {
+        uint64_t accounts[bucket_slots];
+        uint32_t updated_ms[bucket_slots];
+        uint32_t admitted_ms[bucket_slots];
+        float tokens[bucket_slots];
+    };
+    
+    struct alignas(64) Shard {
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+        std::vector<Bucket> buckets;
+        size_t bucket_mask{0};
+        unsigned long long admitted{0};
+        unsigned long long limited{0};
+        unsigned long long duplicates{0};
+        unsigned long long evicted{0};
+        unsigned long long table_full{0};
+    };
+    
+    std::vector<Shard> shards;
+    float tokens_per_ms;
+    float burst;
+    uint32_t dedup_ms;
+    uint32_t idle_ms;
+    std::chrono::steady_clock::time_point epoch;
+    
+    std::mutex sweeper_mtx;
+    std::condition_variable sweeper_cv;
+    bool stopping{false};
+    std::thread sweeper;
+    
+    static uint64_t mix(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+    
+    // Callers read the clock before taking the shard lock, so now_ms can be a
+    // little older than a time already stored in a slot. Taking the difference
+    // as signed and clamping it at zero keeps that from wrapping into a gap of
+    // about 49 days, which would refill the bucket and skip the duplicate check.
+    static uint32_t elapsedMs(uint32_t now_ms, uint32_t since_ms) {
+        int32_t elapsed = static_cast<int32_t>(now_ms - since_ms);
+        return elapsed > 0 ? static_cast<uint32_t>(elapsed) : 0;
+    }
+    
+    static int findAccount(const Bucket& bucket, uint64_t account) {
+        unsigned matches = 0;
+        for (int i = 0; i < bucket_slots; i++) {
+            matches |= static_cast<unsigned>(bucket.accounts[i] == account) << i;
+        }
+        return matches != 0 ? __builtin_ctz(matches) : -1;
+    }
+    
+    // Reusing an active account's slot would hand it a fresh burst and forget
+    // its last admission, so only an empty slot or the least recently seen
+    // idle one qualifies.
+    int freeSlot(const Bucket& bucket, uint32_t now_ms) const {
+        int slot = -1;
+        for (int i = 0; i < bucket_slots; i++) {
+            if (bucket.accounts[i] == 0) {
+                return i;
+            }
+            if (elapsedMs(now_ms, bucket.updated_ms[i]) >= idle_ms &&
+                (slot < 0 || elapsedMs(now_ms, bucket.updated_ms[i]) > elapsedMs(now_ms, bucket.updated_ms[slot]))) {
+                slot = i;
+            }
+        }
+        return slot;
+    }
+    
+    static void lock(Shard& shard) {
+        for (int spins = 0; shard.lock.test_and_set(std::memory_order_acquire); spins++) {
+            // The holder may have been preempted; stop burning its time slice.
+            if (spins >= 64) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    
+    static void unlock(Shard& shard) {
+        shard.lock.clear(std::memory_order_release);
+    }
+    
+    void sweepLoop() {
+        std::unique_lock<std::mutex> guard(sweeper_mtx);
+        while (!sweeper_cv.wait_for(guard, std::chrono::milliseconds(std::max<uint32_t>(idle_ms / 4, 10)),
+                                    [this]() { return stopping; })) {
+            sweep(nowMs());
+        }
+    }
+
+public:
+    // Account ids are non-zero; zero marks an empty slot.
+    IngestionGuard(double per_minute, int burst_size, int dedup_window_ms, size_t capacity)
+        : shards(1 << shard_bits), tokens_per_ms(static_cast<float>(per_minute / 60000.0)),
+          burst(static_cast<float>(burst_size)), dedup_ms(dedup_window_ms),
+          epoch(std::chrono::steady_clock::now()) {
+        // An idle account's bucket has refilled completely after this long,
+        // so dropping it loses nothing.
+        idle_ms = std::max<uint32_t>(dedup_ms, static_cast<uint32_t>(burst / std::max(tokens_per_ms, 1e-9f)));
+        // At a quarter full, with a second bucket to spill into, a new account
+        // almost never finds both of its buckets full of active ones.
+        size_t buckets = 1;
+        while (buckets * bucket_slots * shards.size() < capacity * 4) {
+            buckets <<= 1;
+        }
+        for (auto& shard : shards) {
+            shard.buckets.assign(buckets, Bucket{});
+            shard.bucket_mask = buckets - 1;
+        }
+        sweeper = std::thread(&IngestionGuard::sweepLoop, this);
+    }
+    
+    ~IngestionGuard() {
+        {
+            std::lock_guard<std::mutex> guard(sweeper_mtx);
+            stopping = true;
+        }
+        sweeper_cv.notify_all();
+        sweeper.join();
+    }
+    
+    IngestionGuard(const IngestionGuard&) = delete;
+    IngestionGuard& operator=(const IngestionGuard&) = delete;
+    
+    uint32_t nowMs() const {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - epoch).count());
+    }
+    
+    Verdict admit(uint64_t account, uint32_t now_ms) {
+        uint64_t hash = mix(account);
+        Shard& shard = shards[hash >> (64 - shard_bits)];
+        lock(shard);
+        
+        Bucket& home = shard.buckets[hash & shard.bucket_mask];
+        Bucket& spill = shard.buckets[mix(hash) & shard.bucket_mask];
+        int slot = findAccount(home, account);
+        bool spilled = slot < 0 && (slot = findAccount(spill, account)) >= 0;
+        bool inserted = slot < 0;
+        if (inserted) {
+            spilled = (slot = freeSlot(home, now_ms)) < 0 && (slot = freeSlot(spill, now_ms)) >= 0;
+            if (slot < 0) {
+                shard.table_full++;
+                unlock(shard);
+                return RateLimited;
+            }
+        }
+        Bucket& bucket = spilled ? spill : home;
+        if (inserted) {
+            shard.evicted += bucket.accounts[slot] != 0;
+            bucket.accounts[slot] = account;
+            bucket.updated_ms[slot] = now_ms;
+            bucket.admitted_ms[slot] = now_ms - dedup_ms - 1;
+            bucket.tokens[slot] = burst;
+        }
+        
+        Verdict verdict;
+        uint32_t elapsed = elapsedMs(now_ms, bucket.updated_ms[slot]);
+        float tokens = std::min(burst, bucket.tokens[slot] + elapsed * tokens_per_ms);
+        bucket.updated_ms[slot] += elapsed;
+        if (elapsedMs(now_ms, bucket.admitted_ms[slot]) < dedup_ms) {
+            verdict = Duplicate;
+            shard.duplicates++;
+        } else if (tokens < 1.0f) {
+            verdict = RateLimited;
+            shard.limited++;
+        } else {
+            tokens -= 1.0f;
+            bucket.admitted_ms[slot] = bucket.updated_ms[slot];
+            verdict = Admitted;
+            shard.admitted++;
+        }
+        bucket.tokens[slot] = tokens;
+        
+        unlock(shard);
+        return verdict;
+    }
+    
+    void sweep(uint32_t now_ms) {
+        for (auto& shard : shards) {
+            lock(shard);
+            for (auto& bucket : shard.buckets) {
+                for (int i = 0; i < bucket_slots; i++) {
+                    if (bucket.accounts[i] != 0 && elapsedMs(now_ms, bucket.updated_ms[i]) > idle_ms) {
+                        bucket.accounts[i] = 0;
+                    }
+                }
+            }
+            unlock(shard);
+        }
+    }
+    
+    struct Counts {
+        unsigned long long admitted{0};
+        unsigned long long limited{0};
+        unsigned long long duplicates{0};
+        unsigned long long evicted{0};
+        unsigned long long table_full{0};
+    };
+    
+    Counts counts() {
+        Counts total;
+        for (auto& shard : shards) {
+            lock(shard);
+            total.admitted += shard.admitted;
+            total.limited += shard.limited;
+            total.duplicates += shard.duplicates;
+            total.evicted += shard.evicted;
+            total.table_full += shard.table_full;
+            unlock(shard);
+        }
+        return total;
+    }
+};
+
+// Approximate per-account statistics for the enqueue path: HyperLogLog
+// unique-account counts per UTC hour, and a Count-Min sketch with a top-k
+// candidate list for accounts that re-queue abnormally often. Every producing
+// thread records into its own Writer with relaxed single-writer atomics and
+// no locks; report() merges all writers on read (register max for
+// HyperLogLog, counter sums for Count-Min). Memory is fixed per writer no
+// matter how many accounts there are.
+class AccountAnalytics {
+public:
+    static constexpr int hll_bits = 13;
+    static constexpr int hll_registers = 1 << hll_bits;
+    static constexpr int hour_slots = 24;
+    static constexpr int cm_depth = 4;
+    static constexpr int cm_width_bits = 14;
+    static constexpr int cm_width = 1 << cm_width_bits;
+    static_assert(cm_depth * cm_width_bits <= 64, "every row needs its own hash bits");
+    static constexpr int candidate_slots = 64;
+    
+    class alignas(64) Writer {
+        friend class AccountAnalytics;
+        
+        std::atomic<int64_t> hour_tags[hour_slots];
+        std::atomic<uint8_t> registers[hour_slots][hll_registers];
+        alignas(64) std::atomic<uint32_t> counters[cm_depth][cm_width];
+        std::atomic<uint64_t> candidates[candidate_slots];
+        std::atomic<uint64_t> recorded{0};
+        // Owner-only bookkeeping for choosing which candidate to replace.
+        uint32_t candidate_counts[candidate_slots]{};
+        uint32_t candidate_floor{0};
+        
+        void track(uint64_t account, uint32_t estimate) {
+            int lowest = 0;
+            for (int i = 0; i < candidate_slots; i++) {
+                if (candidates[i].load(std::memory_order_relaxed) == account) {
+                    candidate_counts[i] = estimate;
+                    lowest = -1;
+                    break;
+                }
+                if (candidate_counts[i] < candidate_counts[lowest]) {
+                    lowest = i;
+                }
+            }
+            if (lowest >= 0) {
+                candidates[lowest].store(account, std::memory_order_relaxed);
+                candidate_counts[lowest] = estimate;
+            }
+            candidate_floor = *std::min_element(candidate_counts, candidate_counts + candidate_slots);
+        }
+        
+    public:
+        Writer() {
+            for (auto& tag : hour_tags) {
+                tag.store(-1, std::memory_order_relaxed);
+            }
+        }
+        
+        void record(uint64_t account, int64_t hour) {
+            uint64_t hash = mix(account);
+            
+            int slot = static_cast<int>(hour % hour_slots);
+            if (hour_tags[slot].load(std::memory_order_relaxed) != hour) {
+                for (auto& reg : registers[slot]) {
+                    reg.store(0, std::memory_order_relaxed);
+                }
+                hour_tags[slot].store(hour, std::memory_order_release);
+            }
+            std::atomic<uint8_t>& reg = registers[slot][hash >> (64 - hll_bits)];
+            uint8_t rank = static_cast<uint8_t>(__builtin_clzll((hash << hll_bits) | (1ULL << (hll_bits - 1))) + 1);
+            if (rank > reg.load(std::memory_order_relaxed)) {
+                reg.store(rank, std::memory_order_relaxed);
+            }
+            
+            // Conservative update: counters only grow to the new minimum,
+            // which keeps the overcount far below the plain Count-Min bound.
+            uint64_t columns = mix(hash);
+            std::atomic<uint32_t>* row_counters[cm_depth];
+            uint32_t values[cm_depth];
+            uint32_t estimate = std::numeric_limits<uint32_t>::max();
+            for (int row = 0; row < cm_depth; row++) {
+                row_counters[row] = &counters[row][cmColumn(columns, row)];
+                values[row] = row_counters[row]->load(std::memory_order_relaxed);
+                estimate = std::min(estimate, values[row]);
+            }
+            estimate++;
+            for (int row = 0; row < cm_depth; row++) {
+                row_counters[row]->store(std::max(values[row], estimate), std::memory_order_relaxed);
+            }
+            // Heavy hitters are re-checked every eighth request, which is
+            // plenty to keep them listed and keeps light accounts cheap.
+            if ((estimate & 7) == 0 && estimate > candidate_floor) {
+                track(account, estimate);
+            }
+            recorded.store(recorded.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    };
+    
+    struct HeavyHitter {
+        uint64_t account;
+        uint64_t requests;
+    };
+    
+    struct Report {
+        std::vector<std::pair<int64_t, double>> unique_per_hour;
+        double unique_total{0.0};
+        std::vector<HeavyHitter> heavy_hitters;
+        uint64_t requests{0};
+        double overcount_bound{0.0};
+        size_t memory_bytes{0};
+    };
+
+private:
+    std::mutex writers_mtx;
+    std::vector<std::unique_ptr<Writer>> writers;
+    
+    // Every row takes its column from separate bits of a second hash (the
+    // first also feeds HyperLogLog), so the rows collide independently as
+    // the Count-Min bound requires.
+    static int cmColumn(uint64_t columns, int row) {
+        return static_cast<int>((columns >> (cm_width_bits * row)) & (cm_width - 1));
+    }
+    
+    static uint64_t mix(uint64_t key) {
+        key += 0x9e3779b97f4a7c15ULL;
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+    
+    static double estimateCardinality(const std::vector<uint8_t>& merged) {
+        double sum = 0.0;
+        int zeros = 0;
+        for (uint8_t value : merged) {
+            sum += std::ldexp(1.0, -value);
+            zeros += value == 0;
+        }
+        double m = hll_registers;
+        double estimate = 0.7213 / (1.0 + 1.079 / m) * m * m / sum;
+        // Linear counting is more accurate while many registers are empty.
+        if (estimate <= 2.5 * m && zeros > 0) {
+            estimate = m * std::log(m / zeros);
+        }
+        return estimate;
+    }
+
+public:
+    static int64_t currentHour() {
+        return std::chrono::duration_cast<std::chrono::hours>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+    
+    // Each thread that records takes its own writer once and keeps it.
+    Writer& writer() {
+        std::lock_guard<std::mutex> lock(writers_mtx);
+        writers.push_back(std::make_unique<Writer>());
+        return *writers.back();
+    }
+    
+    Report report(int top_k = 10) {
+        std::lock_guard<std::mutex> lock(writers_mtx);
+        Report result;
+        result.memory_bytes = writers.size() * sizeof(Writer);
+        
+        std::map<int64_t, std::vector<uint8_t>> hours;
+        std::vector<uint8_t> all_hours(hll_registers, 0);
+        std::vector<uint64_t> counters(cm_depth * cm_width, 0);
+        std::vector<uint64_t> candidates;
+        for (const auto& writer : writers) {
+            for (int slot = 0; slot < hour_slots; slot++) {
+                int64_t hour = writer->hour_tags[slot].load(std::memory_order_acquire);
+                if (hour < 0) {
+                    continue;
+                }
+                auto& merged = hours.try_emplace(hour, hll_registers, 0).first->second;
+                for (int i = 0; i < hll_registers; i++) {
+                    uint8_t value = writer->registers[slot][i].load(std::memory_order_relaxed);
+                    merged[i] = std::max(merged[i], value);
+                    all_hours[i] = std::max(all_hours[i], value);
+                }
+            }
+            for (int row = 0; row < cm_depth; row++) {
+                for (int column = 0; column < cm_width; column++) {
+                    counters[row * cm_width + column] += writer->counters[row][column].load(std::memory_order_relaxed);
+                }
+            }
+            for (const auto& candidate : writer->candidates) {
+                uint64_t account = candidate.load(std::memory_order_relaxed);
+                if (account != 0) {
+                    candidates.push_back(account);
+                }
+            }
+            result.requests += writer->recorded.load(std::memory_order_relaxed);
+        }
+        
+        for (const auto& [hour, merged] : hours) {
+            result.unique_per_hour.emplace_back(hour, estimateCardinality(merged));
+        }
+        result.unique_total = estimateCardinality(all_hours);
+        
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+        for (uint64_t account : candidates) {
+            uint64_t columns = mix(mix(account));
+            uint64_t estimate = std::numeric_limits<uint64_t>::max();
+            for (int row = 0; row < cm_depth; row++) {
+                estimate = std::min(estimate, counters[row * cm_width + cmColumn(columns, row)]);
+            }
+            result.heavy_hitters.push_back({account, estimate});
+        }
+        std::sort(result.heavy_hitters.begin(), result.heavy_hitters.end(),
+                  [](const HeavyHitter& a, const HeavyHitter& b) { return a.requests > b.requests; });
+        if (static_cast<int>(result.heavy_hitters.size()) > top_k) {
+            result.heavy_hitters.resize(top_k);
+        }
+        // Count-Min never undercounts and overcounts by at most e/width of
+        // all requests with probability 1 - e^-depth.
+        result.overcount_bound = std::exp(1.0) / cm_width * result.requests;
+        return result;
+    }
+    
+    static void print(const Report& report) {
+        std::cout << "Unique accounts (HyperLogLog, ~" << std::fixed << std::setprecision(1)
+                  << 104.0 / std::sqrt(static_cast<double>(hll_registers)) << "% error) - last "
+                  << report.unique_per_hour.size() << " hour(s): " << std::setprecision(0) << report.unique_total;
+        for (const auto& [hour, unique] : report.unique_per_hour) {
+            std::cout << (hour == report.unique_per_hour.front().first ? " | " : ", ") << std::setw(2)
+                      << std::setfill('0') << hour % 24 << ":00 UTC " << std::setfill(' ') << unique;
+        }
+        std::cout << std::endl;
+        std::cout << "Most frequent accounts (Count-Min, +" << report.overcount_bound << " of " << report.requests
+                  << " requests) -";
+        for (size_t i = 0; i < report.heavy_hitters.size(); i++) {
+            std::cout << (i > 0 ? ", " : " ") << report.heavy_hitters[i].account << ": "
+                      << report.heavy_hitters[i].requests;
+        }
+        std::cout << std::endl;
+        std::cout << "Account statistics memory: " << report.memory_bytes / 1024 << " KiB" << std::endl;
+    }
+};
+
+#endif
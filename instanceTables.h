@@ -0,0 +1,227 @@
+#ifndef INSTANCE_TABLES_H
+#define INSTANCE_TABLES_H
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+ * Per-instance tables shared by dungeonManager and dungeonManagerProducer.
+ * Tables are anonymous mappings the kernel zero-fills on first touch, so
+ * millions of instances cost nothing until used, and the status views
+ * summarize them as a distribution plus the busiest and least busy
+ * instances instead of one line each.
+ */
+
+enum class PageMode { normal, transparent, hugetlb };
+
+inline const char* pageModeName(PageMode mode) {
+    return mode == PageMode::hugetlb ? "hugetlbfs" : mode == PageMode::transparent ? "transparent" : "4 KiB";
+}
+
+constexpr size_t huge_page_bytes = 2 << 20;
+
+// Maps zeroed anonymous memory for a large table. With PageMode::transparent
+// the region is rounded to 2 MiB and aligned so every part of it can be a
+// transparent huge page; PageMode::hugetlb takes pages from the hugetlbfs pool
+// and falls back to transparent ones when none are reserved. Regions under
+// 2 MiB always use normal pages. mapped_bytes and mode receive what was
+// actually mapped; returns nullptr on failure.
+inline void* mapArena(size_t bytes, PageMode& mode, size_t& mapped_bytes) {
+    if (bytes < huge_page_bytes) {
+        mode = PageMode::normal;
+    }
+    if (mode == PageMode::normal) {
+        mapped_bytes = bytes;
+        void* mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        return mapping == MAP_FAILED ? nullptr : mapping;
+    }
+    
+    mapped_bytes = (bytes + huge_page_bytes - 1) & ~(huge_page_bytes - 1);
+#ifdef MAP_HUGETLB
+    if (mode == PageMode::hugetlb) {
+        // No MAP_NORESERVE: without reserved pool pages the mapping fails
+        // here instead of raising SIGBUS on first touch.
+        void* mapping = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapping != MAP_FAILED) {
+            return mapping;
+        }
+    }
+#endif
+    mode = PageMode::transparent;
+    void* reserved = mmap(nullptr, mapped_bytes + huge_page_bytes, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(reserved);
+    uintptr_t aligned = (start + huge_page_bytes - 1) & ~(huge_page_bytes - 1);
+    if (aligned > start) {
+        munmap(reserved, aligned - start);
+    }
+    munmap(reinterpret_cast<void*>(aligned + mapped_bytes), start + huge_page_bytes - aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(reinterpret_cast<void*>(aligned), mapped_bytes, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<void*>(aligned);
+}
+
+// Bytes of [address, address + bytes) currently backed by huge pages, from
+// /proc/self/smaps; -1 if it cannot be read.
+inline long long hugePageBytes(const void* address, size_t bytes) {
+    std::ifstream smaps("/proc/self/smaps");
+    if (!smaps) {
+        return -1;
+    }
+    uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+    uintptr_t end = begin + bytes;
+    long long total = 0;
+    bool inside = false;
+    bool hugetlb = false;
+    std::string line;
+    while (std::getline(smaps, line)) {
+        unsigned long low = 0;
+        unsigned long high = 0;
+        if (std::sscanf(line.c_str(), "%lx-%lx ", &low, &high) == 2) {
+            inside = low < end && high > begin;
+            hugetlb = false;
+            continue;
+        }
+        long long kib = 0;
+        if (!inside) {
+            continue;
+        }
+        if (std::sscanf(line.c_str(), "AnonHugePages: %lld kB", &kib) == 1) {
+            total += kib * 1024;
+        } else if (std::sscanf(line.c_str(), "KernelPageSize: %lld kB", &kib) == 1) {
+            hugetlb = kib >= 2048;
+        } else if (hugetlb && std::sscanf(line.c_str(), "Private_Hugetlb: %lld kB", &kib) == 1) {
+            total += kib * 1024;
+        }
+    }
+    return std::min<long long>(total, static_cast<long long>(bytes));
+}
+
+template <typename T>
+class LazyInstanceArray {
+private:
+    T* data{nullptr};
+    size_t bytes{0};
+    size_t mapped_bytes{0};
+    bool owned{true};
+
+public:
+    explicit LazyInstanceArray(size_t count, PageMode mode = PageMode::normal)
+        : bytes(std::max<size_t>(count * sizeof(T), 1)) {
+        void* mapping = mapArena(bytes, mode, mapped_bytes);
+        if (mapping == nullptr) {
+            throw std::bad_alloc();
+        }
+        data = static_cast<T*>(mapping);
+    }
+
+    // A view of a page-aligned array that lives in someone else's mapping.
+    LazyInstanceArray(T* external, size_t count)
+        : data(external), bytes(std::max<size_t>(count * sizeof(T), 1)), owned(false) {}
+    
+    ~LazyInstanceArray() {
+        if (owned) {
+            munmap(data, mapped_bytes);
+        }
+    }
+
+    LazyInstanceArray(const LazyInstanceArray&) = delete;
+    LazyInstanceArray& operator=(const LazyInstanceArray&) = delete;
+
+    T& operator[](size_t i) { return data[i]; }
+    const T& operator[](size_t i) const { return data[i]; }
+
+    size_t sizeInBytes() const { return bytes; }
+
+    bool prefault(size_t offset, size_t length) {
+#ifdef MADV_POPULATE_WRITE
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t begin = offset / page * page;
+        size_t end = std::min(bytes, offset + length);
+        if (begin >= end) {
+            return true;
+        }
+        return madvise(reinterpret_cast<char*>(data) + begin, end - begin, MADV_POPULATE_WRITE) == 0;
+#else
+        return false;
+#endif
+    }
+};
+
+struct InstanceDistribution {
+    double min{0.0};
+    double q1{0.0};
+    double median{0.0};
+    double q3{0.0};
+    double max{0.0};
+    double gini{0.0};
+};
+
+// Instances past the end of values were never used and count as zero.
+inline InstanceDistribution summarizeInstances(std::vector<int> values, int instance_count) {
+    InstanceDistribution summary;
+    if (instance_count <= 0) {
+        return summary;
+    }
+    
+    std::sort(values.begin(), values.end());
+    int zeros = instance_count - static_cast<int>(values.size());
+    auto at = [&](int rank) {
+        return rank < zeros ? 0.0 : static_cast<double>(values[rank - zeros]);
+    };
+    auto quantile = [&](double q) {
+        double position = q * (instance_count - 1);
+        int lower = static_cast<int>(position);
+        int upper = std::min(lower + 1, instance_count - 1);
+        return at(lower) + (at(upper) - at(lower)) * (position - lower);
+    };
+    
+    summary.min = at(0);
+    summary.q1 = quantile(0.25);
+    summary.median = quantile(0.5);
+    summary.q3 = quantile(0.75);
+    summary.max = at(instance_count - 1);
+    
+    double total = 0.0;
+    double weighted = 0.0;
+    for (size_t i = 0; i < values.size(); i++) {
+        double rank = zeros + i + 1.0;
+        total += values[i];
+        weighted += (2.0 * rank - instance_count - 1.0) * values[i];
+    }
+    summary.gini = total > 0 ? weighted / (static_cast<double>(instance_count) * total) : 0.0;
+    return summary;
+}
+
+inline std::vector<int> rankInstances(const std::vector<int>& served, int k, bool busiest) {
+    std::vector<int> ids(served.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        ids[i] = static_cast<int>(i);
+    }
+    k = std::min(k, static_cast<int>(ids.size()));
+    std::partial_sort(ids.begin(), ids.begin() + k, ids.end(), [&](int a, int b) {
+        if (served[a] != served[b]) {
+            return busiest ? served[a] > served[b] : served[a] < served[b];
+        }
+        return busiest ? a < b : a > b;
+    });
+    ids.resize(k);
+    return ids;
+}
+
+#endif
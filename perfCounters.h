@@ -0,0 +1,156 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+ * Hardware and software counters read through perf_event_open(2), grouped so
+ * they start and stop together. Used by the producer's --bench and the TLB
+ * benchmark; counters the kernel or the machine does not offer read as -1.
+ */
+
+class PerfCounterGroup {
+private:
+    struct Counter {
+        std::string name;
+        int fd{-1};
+        int error{0};
+        uint64_t value{0};
+    };
+    
+    std::vector<Counter> counters;
+    
+    static int openCounter(uint32_t type, uint64_t config, bool exclude_kernel) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = exclude_kernel ? 1 : 0;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+    
+    void add(const std::string& name, uint32_t type, uint64_t config) {
+        Counter counter;
+        counter.name = name;
+        counter.fd = openCounter(type, config, false);
+        if (counter.fd < 0) {
+            counter.fd = openCounter(type, config, true);
+        }
+        if (counter.fd < 0) {
+            counter.error = errno;
+        }
+        counters.push_back(counter);
+    }
+
+public:
+    // tlb swaps the cache counters for data-TLB misses.
+    explicit PerfCounterGroup(bool tlb = false) {
+        if (tlb) {
+            add("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            add("dTLB-load-misses", PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            add("dTLB-store-misses", PERF_TYPE_HW_CACHE,
+                PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_WRITE << 8) |
+                (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+            return;
+        }
+        add("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        add("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        add("cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        add("LLC-load-misses", PERF_TYPE_HW_CACHE,
+            PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        add("context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+    }
+    
+    ~PerfCounterGroup() {
+        for (auto& counter : counters) {
+            if (counter.fd >= 0) {
+                close(counter.fd);
+            }
+        }
+    }
+    
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+    
+    void start() {
+        for (auto& counter : counters) {
+            if (counter.fd >= 0) {
+                ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+    
+    void stop() {
+        for (auto& counter : counters) {
+            if (counter.fd < 0) {
+                continue;
+            }
+            ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(counter.fd, &counter.value, sizeof(counter.value)) != sizeof(counter.value)) {
+                counter.error = errno;
+                close(counter.fd);
+                counter.fd = -1;
+            }
+        }
+    }
+    
+    // The counter's value, or -1 if it is unavailable or not in the group.
+    long long value(const std::string& name) const {
+        for (const auto& counter : counters) {
+            if (counter.name == name) {
+                return counter.fd >= 0 ? static_cast<long long>(counter.value) : -1;
+            }
+        }
+        return -1;
+    }
+    
+    void reportJson(std::ostream& out) const {
+        out << "{";
+        for (size_t i = 0; i < counters.size(); i++) {
+            out << (i > 0 ? "," : "") << "\"" << counters[i].name << "\":";
+            if (counters[i].fd < 0) {
+                out << "null";
+            } else {
+                out << counters[i].value;
+            }
+        }
+        out << "}";
+    }
+    
+    void report(std::ostream& out, uint64_t per_unit_count, const std::string& unit) const {
+        for (const auto& counter : counters) {
+            out << std::setw(18) << counter.name << ": ";
+            if (counter.fd < 0) {
+                out << "unavailable (" << std::strerror(counter.error) << ")" << std::endl;
+                continue;
+            }
+            out << counter.value;
+            if (per_unit_count > 0) {
+                out << " (" << std::fixed << std::setprecision(2)
+                    << static_cast<double>(counter.value) / per_unit_count << " per " << unit << ")";
+            }
+            out << std::endl;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,1527 @@
+#ifndef QUEUE_MANAGER_H
+#define QUEUE_MANAGER_H
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bulkRandom.h"
+#include "ddSketch.h"
+#include "eventOutput.h"
+#include "ingestionGuard.h"
+#include "instanceTables.h"
+#include "perfCounters.h"
+#include "queueStore.h"
+#include "scenarioSchedule.h"
+
+/*
+ * The real-time DungeonManager: instance threads form parties from the
+ * shared role queues while producers enqueue, with the arrival forecaster and
+ * status dashboard it reports through. Shared by dungeonManagerProducer and
+ * the stressTest harness.
+ */
+
+class ArrivalForecaster {
+private:
+    static constexpr double level_smoothing = 0.3;
+    static constexpr double trend_smoothing = 0.1;
+    static constexpr long long max_catch_up_buckets = 1024;
+    
+    std::chrono::steady_clock::duration bucket_length;
+    std::chrono::steady_clock::time_point bucket_start;
+    long long bucket_counts[3]{0, 0, 0};
+    double level[3]{0.0, 0.0, 0.0};
+    double trend[3]{0.0, 0.0, 0.0};
+    bool initialized{false};
+    
+    double absolute_error[3]{0.0, 0.0, 0.0};
+    double actual_total[3]{0.0, 0.0, 0.0};
+    long long scored_buckets{0};
+    
+    void closeBucket() {
+        for (int role = 0; role < 3; role++) {
+            double actual = static_cast<double>(bucket_counts[role]);
+            if (!initialized) {
+                level[role] = actual;
+                trend[role] = 0.0;
+            } else {
+                double predicted = std::max(0.0, level[role] + trend[role]);
+                absolute_error[role] += std::fabs(actual - predicted);
+                actual_total[role] += actual;
+                
+                double previous_level = level[role];
+                level[role] = level_smoothing * actual + (1.0 - level_smoothing) * (level[role] + trend[role]);
+                trend[role] = trend_smoothing * (level[role] - previous_level) + (1.0 - trend_smoothing) * trend[role];
+            }
+            bucket_counts[role] = 0;
+        }
+        if (initialized) {
+            scored_buckets++;
+        }
+        initialized = true;
+    }
+
+public:
+    explicit ArrivalForecaster(std::chrono::milliseconds bucket)
+        : bucket_length(bucket), bucket_start(std::chrono::steady_clock::now()) {
+    }
+    
+    void advanceTo(std::chrono::steady_clock::time_point now) {
+        if (now - bucket_start < bucket_length) {
+            return;
+        }
+        
+        long long elapsed_buckets = (now - bucket_start) / bucket_length;
+        if (elapsed_buckets > max_catch_up_buckets) {
+            bucket_start += bucket_length * (elapsed_buckets - max_catch_up_buckets);
+        }
+        while (now - bucket_start >= bucket_length) {
+            closeBucket();
+            bucket_start += bucket_length;
+        }
+    }
+    
+    void recordArrivals(int tanks, int healers, int dps, std::chrono::steady_clock::time_point now) {
+        advanceTo(now);
+        bucket_counts[0] += tanks;
+        bucket_counts[1] += healers;
+        bucket_counts[2] += dps;
+    }
+    
+    double forecast(int role, std::chrono::seconds horizon) const {
+        if (!initialized) {
+            return 0.0;
+        }
+        double buckets = std::chrono::duration<double>(horizon) / bucket_length;
+        double total = buckets * level[role] + trend[role] * buckets * (buckets + 1.0) / 2.0;
+        return std::max(0.0, total);
+    }
+    
+    double meanAbsoluteError(int role) const {
+        return scored_buckets > 0 ? absolute_error[role] / scored_buckets : 0.0;
+    }
+    
+    double weightedPercentError(int role) const {
+        return actual_total[role] > 0 ? absolute_error[role] / actual_total[role] * 100.0 : 0.0;
+    }
+    
+    long long scoredBuckets() const {
+        return scored_buckets;
+    }
+};
+
+struct DashboardSnapshot {
+    static constexpr int top_k = 5;
+    
+    mutable std::atomic<unsigned> sequence{0};
+    std::atomic<int> queued[3]{};
+    std::atomic<int> active_instances{0};
+    std::atomic<int> used_instances{0};
+    std::atomic<int> instance_threads{0};
+    std::atomic<int> parties_formed{0};
+    std::atomic<int> players_added{0};
+    std::atomic<int> top_ids[top_k]{};
+    std::atomic<int> top_served[top_k]{};
+    
+    struct Values {
+        int queued[3];
+        int active_instances;
+        int used_instances;
+        int instance_threads;
+        int parties_formed;
+        int players_added;
+        int top_ids[top_k];
+        int top_served[top_k];
+    };
+    
+    Values read() const {
+        Values values;
+        while (true) {
+            unsigned before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            for (int role = 0; role < 3; role++) {
+                values.queued[role] = queued[role].load(std::memory_order_relaxed);
+            }
+            values.active_instances = active_instances.load(std::memory_order_relaxed);
+            values.used_instances = used_instances.load(std::memory_order_relaxed);
+            values.instance_threads = instance_threads.load(std::memory_order_relaxed);
+            values.parties_formed = parties_formed.load(std::memory_order_relaxed);
+            values.players_added = players_added.load(std::memory_order_relaxed);
+            for (int i = 0; i < top_k; i++) {
+                values.top_ids[i] = top_ids[i].load(std::memory_order_relaxed);
+                values.top_served[i] = top_served[i].load(std::memory_order_relaxed);
+            }
+            // A read-modify-write with release ordering keeps the field loads
+            // above it without a standalone fence, which TSan cannot model.
+            if (sequence.fetch_add(0, std::memory_order_release) == before) {
+                return values;
+            }
+        }
+    }
+};
+
+class StatusDashboard {
+private:
+    static constexpr int sparkline_width = 60;
+    
+    std::vector<std::string> previous_frame;
+    std::vector<int> queue_history;
+    bool first_frame{true};
+    
+    static std::string bar(int value, int total, int width) {
+        int filled = total > 0 ? static_cast<int>(static_cast<long long>(value) * width / total) : 0;
+        return std::string(filled, '#') + std::string(width - filled, '.');
+    }
+    
+    std::string sparkline() const {
+        static const char* levels[]{"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+        int highest = 1;
+        for (int value : queue_history) {
+            highest = std::max(highest, value);
+        }
+        std::string line;
+        for (int value : queue_history) {
+            line += levels[std::min(7, value * 8 / (highest + 1))];
+        }
+        return line + " (max " + std::to_string(highest) + ")";
+    }
+
+public:
+    void render(const DashboardSnapshot::Values& values, int instance_count, double elapsed_seconds,
+                int runtime_seconds) {
+        int queued_total = values.queued[0] + values.queued[1] + values.queued[2];
+        queue_history.push_back(queued_total);
+        if (static_cast<int>(queue_history.size()) > sparkline_width) {
+            queue_history.erase(queue_history.begin());
+        }
+        
+        int idle = values.used_instances - values.active_instances;
+        int cold = instance_count - values.used_instances;
+        std::vector<std::string> frame;
+        std::ostringstream line;
+        auto emit = [&]() {
+            frame.push_back(line.str());
+            line.str("");
+        };
+        
+        line << "=== MMORPG Dungeon LFG Queue System === " << std::fixed << std::setprecision(1)
+             << elapsed_seconds << "s / " << runtime_seconds << "s";
+        emit();
+        emit();
+        line << "Instances: " << instance_count << " | Threads: " << values.instance_threads;
+        emit();
+        line << "  ACTIVE " << std::setw(10) << values.active_instances << " " << bar(values.active_instances, instance_count, 40);
+        emit();
+        line << "  IDLE   " << std::setw(10) << idle << " " << bar(idle, instance_count, 40);
+        emit();
+        line << "  UNUSED " << std::setw(10) << cold << " " << bar(cold, instance_count, 40);
+        emit();
+        emit();
+        line << "Queue - Tanks: " << values.queued[0] << ", Healers: " << values.queued[1]
+             << ", DPS: " << values.queued[2];
+        emit();
+        line << "Queue " << sparkline();
+        emit();
+        emit();
+        line << "Busiest instances:";
+        emit();
+        for (int i = 0; i < DashboardSnapshot::top_k; i++) {
+            if (values.top_served[i] > 0) {
+                line << "  #" << (i + 1) << " Instance " << (values.top_ids[i] + 1) << ": "
+                     << values.top_served[i] << " parties";
+            }
+            emit();
+        }
+        emit();
+        line << "Parties formed: " << values.parties_formed << " | Players added: " << values.players_added;
+        emit();
+        
+        std::string output;
+        if (first_frame) {
+            output += "\x1b[2J\x1b[?25l";
+            first_frame = false;
+        }
+        for (size_t row = 0; row < frame.size(); row++) {
+            if (row < previous_frame.size() && previous_frame[row] == frame[row]) {
+                continue;
+            }
+            output += "\x1b[" + std::to_string(row + 1) + ";1H" + frame[row] + "\x1b[K";
+        }
+        output += "\x1b[" + std::to_string(frame.size() + 1) + ";1H";
+        previous_frame = std::move(frame);
+        
+        std::cout << output << std::flush;
+    }
+    
+    void finish() {
+        std::cout << "\x1b[?25h" << std::endl;
+    }
+};
+
+class DungeonManager {
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    
+    // Everything that survives a restart lives in the store's image; the
+    // members below that refer into it keep their original names.
+    bool resumed;
+    std::unique_ptr<QueueStore> store;
+    QueueStore::Image& state;
+    
+    int& tank_queue;
+    int& healer_queue;
+    int& dps_queue;
+    
+    int dungeon_count;
+    int instance_limit;
+    LazyInstanceArray<unsigned char> dungeon_active;
+    LazyInstanceArray<int> parties_served;
+    LazyInstanceArray<int> total_time_served;
+    
+    std::vector<std::thread> workers;
+    int idle_workers{0};
+    std::vector<int> free_instances;
+    int& next_instance;
+    int min_dungeon_time{0};
+    int max_dungeon_time{0};
+    int initial_players[3];
+    int producer_interval{0};
+    int runtime_limit{0};
+    std::vector<long long> duration_histogram;
+    DDSketch wait_sketches[3];
+    DDSketch duration_sketch;
+    std::vector<std::thread> prefault_threads;
+    
+    std::chrono::steady_clock::time_point created_at;
+    std::chrono::steady_clock::time_point first_party_at;
+    bool first_party_formed{false};
+    
+    std::atomic<uint64_t> next_seed;
+    
+    std::atomic_ref<int32_t> total_parties_formed;
+    std::atomic_ref<int32_t> total_players_added;
+    
+    long long (&players_added_by_role)[3];
+    long long (&players_cancelled)[3];
+    long long (&players_expired)[3];
+    long long (&players_merged)[3];
+    bool ring_full_reported[3]{};
+    std::chrono::seconds checkpoint_interval{10};
+    std::chrono::steady_clock::time_point last_checkpoint{std::chrono::steady_clock::now()};
+    
+    bool shutdown{false};
+    bool verbose{true};
+    bool full_status{false};
+    static constexpr int summary_rank_count = 5;
+    EventWriter* events{nullptr};
+    ColumnarEventLog* event_log{nullptr};
+    const ScenarioSchedule* scenario{nullptr};
+    IngestionGuard* ingestion_guard{nullptr};
+    AccountAnalytics* account_analytics{nullptr};
+    uint64_t account_count{100000};
+    int spam_rate{0};
+    std::chrono::seconds queue_timeout{0};
+    
+    DashboardSnapshot snapshot;
+    int dashboard_fps{0};
+    
+    ArrivalForecaster forecaster{std::chrono::milliseconds(5000)};
+    std::chrono::seconds forecast_horizon{120};
+    bool forecast_warmup{true};
+
+public:
+    // Starts empty with t, h and d players queued, or resumes a restored
+    // store, in which case n, t, h and d come from its image. pages backs the
+    // queue image and instance tables of a new store (see mapArena).
+    DungeonManager(int n, int t, int h, int d, std::unique_ptr<QueueStore> restored = nullptr,
+                   PageMode pages = PageMode::normal)
+        : resumed(restored != nullptr),
+          store(resumed ? std::move(restored) : std::make_unique<QueueStore>(n, 1 << 18, pages)),
+          state(store->image()),
+          tank_queue(state.queued[0]), healer_queue(state.queued[1]), dps_queue(state.queued[2]),
+          dungeon_count(static_cast<int>(state.instance_count)), instance_limit(dungeon_count),
+          dungeon_active(dungeon_count, pages), parties_served(store->partiesServed(), dungeon_count),
+          total_time_served(store->timeServed(), dungeon_count), next_instance(state.next_instance),
+          created_at(std::chrono::steady_clock::now()),
+          next_seed((static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}()),
+          total_parties_formed(state.parties_formed), total_players_added(state.players_added),
+          players_added_by_role(state.added_by_role), players_cancelled(state.cancelled),
+          players_expired(state.expired), players_merged(state.merged) {
+        if (!resumed) {
+            long long now_us = EventRecord::now();
+            store->seed(0, t, now_us);
+            store->seed(1, h, now_us);
+            store->seed(2, d, now_us);
+        }
+        std::copy(state.initial_players, state.initial_players + 3, initial_players);
+        // Dungeons running at a crash are lost; their instances start free.
+        for (int instance = next_instance - 1; instance >= 0; instance--) {
+            free_instances.push_back(instance);
+        }
+    }
+
+    ~DungeonManager() {
+        for (auto& thread : prefault_threads) {
+            thread.join();
+        }
+    }
+
+    void prefaultInstanceState() {
+        int thread_count = std::max(1u, std::thread::hardware_concurrency());
+        size_t chunk = huge_page_bytes;
+        for (int worker = 0; worker < thread_count; worker++) {
+            prefault_threads.emplace_back([this, worker, thread_count, chunk]() {
+                // parties_served and total_time_served live in the store's image.
+                size_t largest = std::max(dungeon_active.sizeInBytes(), store->imageBytes());
+                for (size_t offset = worker * chunk; offset < largest; offset += thread_count * chunk) {
+                    if (!dungeon_active.prefault(offset, chunk) || !store->prefault(offset, chunk)) {
+                        return;
+                    }
+                }
+            });
+        }
+    }
+
+    int& queuedPlayers(int role) {
+        return role == 0 ? tank_queue : role == 1 ? healer_queue : dps_queue;
+    }
+
+    // Removes up to count of the oldest (front) or newest (back) players of a
+    // role, recording why they left in the columnar event log if there is one
+    // and the waits of matched players in the role's sketch.
+    // Arrival times are wall-clock microseconds so waits carry across a
+    // restart from a state file.
+    int removeQueued(int role, int count, bool oldest_first, ColumnarKind kind) {
+        long long now_us = EventRecord::now();
+        return store->remove(role, count, oldest_first, kind, [&](int64_t arrived_us, int taken) {
+            double wait_seconds = std::max<int64_t>(now_us - arrived_us, 0) / 1e6;
+            if (kind == COLUMNAR_MATCHED) {
+                wait_sketches[role].add(wait_seconds, taken);
+            }
+            if (event_log != nullptr) {
+                for (int i = 0; i < taken; i++) {
+                    event_log->append(now_us, kind, role, 0, static_cast<float>(wait_seconds * 1000.0));
+                }
+            }
+        });
+    }
+
+    // Journals the changes made under the lock. The store stops persisting
+    // after a failed write, so the error is reported once.
+    void commitState() {
+        if (!store->commit()) {
+            std::cerr << "State file: " << store->journalError()
+                      << "; later changes are not persisted" << std::endl;
+        }
+    }
+    
+    int cancelPlayers(int role, int count) {
+        std::lock_guard<std::mutex> lock(mtx);
+        int removed = removeQueued(role, count, false, COLUMNAR_CANCELLED);
+        commitState();
+        publishSnapshot();
+        return removed;
+    }
+
+    int expirePlayers(std::chrono::steady_clock::duration timeout) {
+        std::lock_guard<std::mutex> lock(mtx);
+        int expired = expireLocked(timeout);
+        commitState();
+        return expired;
+    }
+
+    int expireLocked(std::chrono::steady_clock::duration timeout) {
+        long long cutoff_us = EventRecord::now() - std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+        int expired = 0;
+        for (int role = 0; role < 3; role++) {
+            int stale = 0;
+            for (size_t i = 0; i < store->batchCount(role); i++) {
+                const QueueStore::StoredBatch& batch = store->batch(role, i);
+                if (batch.arrived_us > cutoff_us) {
+                    break;
+                }
+                stale += batch.count;
+            }
+            expired += removeQueued(role, stale, true, COLUMNAR_EXPIRED);
+        }
+        if (expired > 0) {
+            publishSnapshot();
+        }
+        return expired;
+    }
+
+    // Checks the conservation laws that every critical section must preserve:
+    // each player added is matched, still queued, cancelled or expired, and
+    // every busy instance thread owns exactly one active instance.
+    bool checkInvariants(std::string& violation) {
+        std::lock_guard<std::mutex> lock(mtx);
+        static const char* role_names[]{"tanks", "healers", "dps"};
+        static constexpr int party_roles[3]{1, 1, 3};
+        std::ostringstream out;
+        
+        for (int role = 0; role < 3; role++) {
+            long long matched = static_cast<long long>(total_parties_formed) * party_roles[role];
+            long long accounted = matched + queuedPlayers(role) + players_cancelled[role] + players_expired[role];
+            if (accounted != players_added_by_role[role]) {
+                out << role_names[role] << ": added " << players_added_by_role[role] << " != matched " << matched
+                    << " + queued " << queuedPlayers(role) << " + cancelled " << players_cancelled[role]
+                    << " + expired " << players_expired[role] << "; ";
+            }
+            long long batched = 0;
+            for (size_t i = 0; i < store->batchCount(role); i++) {
+                batched += store->batch(role, i).count;
+            }
+            if (batched != queuedPlayers(role) || queuedPlayers(role) < 0) {
+                out << role_names[role] << ": queue count " << queuedPlayers(role) << " but arrival batches hold "
+                    << batched << "; ";
+            }
+        }
+        
+        int busy = static_cast<int>(workers.size()) - idle_workers;
+        int active = 0;
+        for (int i = 0; i < next_instance; i++) {
+            active += dungeon_active[i] ? 1 : 0;
+        }
+        if (busy < 0 || active != busy || static_cast<int>(free_instances.size()) + active != next_instance) {
+            out << "instances: " << busy << " busy threads, " << active << " active, " << free_instances.size()
+                << " free of " << next_instance << " used; ";
+        }
+        
+        violation = out.str();
+        return violation.empty();
+    }
+    
+    struct PlayerTotals {
+        long long added[3]{};
+        long long cancelled[3]{};
+        long long expired[3]{};
+    };
+    
+    // The manager's own per-role counts, for harnesses that count what they
+    // sent and removed to compare against.
+    PlayerTotals playerTotals() {
+        std::lock_guard<std::mutex> lock(mtx);
+        PlayerTotals totals;
+        for (int role = 0; role < 3; role++) {
+            totals.added[role] = players_added_by_role[role];
+            totals.cancelled[role] = players_cancelled[role];
+            totals.expired[role] = players_expired[role];
+        }
+        return totals;
+    }
+
+    void setQueueTimeout(int seconds) {
+        queue_timeout = std::chrono::seconds(seconds);
+    }
+
+    bool resumedFromState() const {
+        return resumed;
+    }
+    
+    // Persists the queues and instance table to path from now on; the
+    // journal is synced on every status tick and folded into a checkpoint
+    // every checkpoint_seconds.
+    bool createStateFile(const std::string& path, int t1, int t2, int checkpoint_seconds, std::string& error) {
+        std::lock_guard<std::mutex> lock(mtx);
+        checkpoint_interval = std::chrono::seconds(checkpoint_seconds);
+        store->setDungeonTimes(t1, t2);
+        return store->createFile(path, error);
+    }
+    
+    void setCheckpointInterval(int seconds) {
+        checkpoint_interval = std::chrono::seconds(seconds);
+    }
+    
+    void maintainState(bool force_checkpoint = false) {
+        if (!store->persistent()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        auto now = std::chrono::steady_clock::now();
+        std::string error;
+        bool ok = true;
+        if (force_checkpoint || now - last_checkpoint >= checkpoint_interval) {
+            ok = store->checkpoint(error);
+            last_checkpoint = now;
+        } else if (!store->sync()) {
+            ok = false;
+            error = "Cannot sync the state journal";
+        }
+        if (!ok) {
+            std::cerr << "State file: " << error << std::endl;
+        }
+    }
+    
+    void setVerbose(bool enabled) {
+        verbose = enabled;
+    }
+
+    bool enqueuePlayers(int tanks, int healers, int dps) {
+        std::lock_guard<std::mutex> lock(mtx);
+        addPlayersToQueue(tanks, healers, dps);
+        return !shutdown;
+    }
+
+    void startWorkers(int t1, int t2) {
+        std::lock_guard<std::mutex> lock(mtx);
+        min_dungeon_time = t1;
+        max_dungeon_time = t2;
+        ensureWorkers();
+    }
+
+    void stopWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            shutdown = true;
+            cv.notify_all();
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    int partiesFormed() const {
+        return total_parties_formed;
+    }
+
+    bool canFormParty() {
+        return tank_queue >= 1 && healer_queue >= 1 && dps_queue >= 3 &&
+               static_cast<int>(workers.size()) - idle_workers < instance_limit;
+    }
+
+    void formParty() {
+        removeQueued(0, 1, true, COLUMNAR_MATCHED);
+        removeQueued(1, 1, true, COLUMNAR_MATCHED);
+        removeQueued(2, 3, true, COLUMNAR_MATCHED);
+        
+        if (!first_party_formed) {
+            first_party_formed = true;
+            first_party_at = std::chrono::steady_clock::now();
+        }
+    }
+
+    int acquireInstance() {
+        if (!free_instances.empty()) {
+            int instance_id = free_instances.back();
+            free_instances.pop_back();
+            return instance_id;
+        }
+        return next_instance++;
+    }
+
+    void releaseInstance(int instance_id) {
+        free_instances.push_back(instance_id);
+    }
+
+    void configureForecast(std::chrono::milliseconds bucket, std::chrono::seconds horizon, bool warmup) {
+        std::lock_guard<std::mutex> lock(mtx);
+        forecaster = ArrivalForecaster(bucket);
+        forecast_horizon = horizon;
+        forecast_warmup = warmup;
+    }
+
+    int forecastParties() {
+        double tanks = tank_queue + forecaster.forecast(0, forecast_horizon);
+        double healers = healer_queue + forecaster.forecast(1, forecast_horizon);
+        double dps = dps_queue + forecaster.forecast(2, forecast_horizon);
+        double parties = std::min({tanks, healers, dps / 3.0});
+        return static_cast<int>(std::min<double>(parties, dungeon_count));
+    }
+
+    void publishSnapshot() {
+        snapshot.sequence.fetch_add(1, std::memory_order_acquire);
+        snapshot.queued[0].store(tank_queue, std::memory_order_relaxed);
+        snapshot.queued[1].store(healer_queue, std::memory_order_relaxed);
+        snapshot.queued[2].store(dps_queue, std::memory_order_relaxed);
+        snapshot.active_instances.store(static_cast<int>(workers.size()) - idle_workers, std::memory_order_relaxed);
+        snapshot.used_instances.store(next_instance, std::memory_order_relaxed);
+        snapshot.instance_threads.store(static_cast<int>(workers.size()), std::memory_order_relaxed);
+        snapshot.parties_formed.store(total_parties_formed, std::memory_order_relaxed);
+        snapshot.players_added.store(total_players_added, std::memory_order_relaxed);
+        snapshot.sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    void updateTopInstances(int instance_id) {
+        snapshot.sequence.fetch_add(1, std::memory_order_acquire);
+        
+        int served = parties_served[instance_id];
+        int slot = -1;
+        for (int i = 0; i < DashboardSnapshot::top_k; i++) {
+            if (snapshot.top_served[i].load(std::memory_order_relaxed) > 0 &&
+                snapshot.top_ids[i].load(std::memory_order_relaxed) == instance_id) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot < 0) {
+            slot = DashboardSnapshot::top_k - 1;
+            if (snapshot.top_served[slot].load(std::memory_order_relaxed) >= served) {
+                slot = -1;
+            }
+        }
+        if (slot >= 0) {
+            snapshot.top_ids[slot].store(instance_id, std::memory_order_relaxed);
+            snapshot.top_served[slot].store(served, std::memory_order_relaxed);
+            while (slot > 0 && snapshot.top_served[slot - 1].load(std::memory_order_relaxed) < served) {
+                int id_above = snapshot.top_ids[slot - 1].load(std::memory_order_relaxed);
+                int served_above = snapshot.top_served[slot - 1].load(std::memory_order_relaxed);
+                snapshot.top_ids[slot - 1].store(instance_id, std::memory_order_relaxed);
+                snapshot.top_served[slot - 1].store(served, std::memory_order_relaxed);
+                snapshot.top_ids[slot].store(id_above, std::memory_order_relaxed);
+                snapshot.top_served[slot].store(served_above, std::memory_order_relaxed);
+                slot--;
+            }
+        }
+        
+        snapshot.sequence.fetch_add(1, std::memory_order_release);
+    }
+
+    void setEventLog(ColumnarEventLog* log) {
+        event_log = log;
+    }
+    
+    // Call after the run has finished; the instance threads must be joined.
+    NamedSketches sketches() const {
+        return {{"wait/tank", wait_sketches[0]}, {"wait/healer", wait_sketches[1]},
+                {"wait/dps", wait_sketches[2]}, {"duration", duration_sketch}};
+    }
+    
+    void setEventWriter(EventWriter* writer) {
+        events = writer;
+        if (events != nullptr) {
+            verbose = false;
+        }
+    }
+
+    void emitStatusEvent() {
+        std::lock_guard<std::mutex> lock(mtx);
+        EventRecord record("status", EventRecord::now());
+        record.field("active", static_cast<long long>(workers.size()) - idle_workers)
+              .field("used_instances", next_instance)
+              .field("queued_tanks", tank_queue)
+              .field("queued_healers", healer_queue)
+              .field("queued_dps", dps_queue)
+              .field("parties_formed", total_parties_formed)
+              .field("players_added", total_players_added);
+        events->write(record);
+    }
+
+    std::map<int, int> partiesServedHistogram() {
+        std::map<int, int> histogram;
+        for (int i = 0; i < next_instance; i++) {
+            histogram[parties_served[i]]++;
+        }
+        if (next_instance < dungeon_count) {
+            histogram[0] += dungeon_count - next_instance;
+        }
+        return histogram;
+    }
+
+    std::string summaryJson() {
+        std::string out;
+        auto add = [&out](const char* key, long long value, bool first = false) {
+            out += first ? "\"" : ",\"";
+            out += key;
+            out += "\":";
+            out += std::to_string(value);
+        };
+        
+        out += "{\"config\":{";
+        add("instances", dungeon_count, true);
+        add("initial_tanks", initial_players[0]);
+        add("initial_healers", initial_players[1]);
+        add("initial_dps", initial_players[2]);
+        add("min_dungeon_time", min_dungeon_time);
+        add("max_dungeon_time", max_dungeon_time);
+        add("producer_interval_ms", producer_interval);
+        add("runtime_seconds", runtime_limit);
+        out += "},\"totals\":{";
+        
+        long long total_parties = 0;
+        long long overall_time = 0;
+        for (int i = 0; i < next_instance; i++) {
+            total_parties += parties_served[i];
+            overall_time += total_time_served[i];
+        }
+        add("parties_served", total_parties, true);
+        add("time_served", overall_time);
+        add("parties_formed", total_parties_formed);
+        add("players_added", total_players_added);
+        if (ingestion_guard != nullptr) {
+            IngestionGuard::Counts counts = ingestion_guard->counts();
+            add("requests_admitted", static_cast<long long>(counts.admitted));
+            add("requests_rate_limited", static_cast<long long>(counts.limited));
+            add("requests_duplicate", static_cast<long long>(counts.duplicates));
+            add("requests_table_full", static_cast<long long>(counts.table_full));
+        }
+        if (account_analytics != nullptr) {
+            add("unique_accounts", std::llround(account_analytics->report().unique_total));
+        }
+        add("instance_threads", static_cast<long long>(workers.size()));
+        if (first_party_formed) {
+            add("time_to_first_party_us",
+                std::chrono::duration_cast<std::chrono::microseconds>(first_party_at - created_at).count());
+        }
+        out += "},\"remaining\":{";
+        add("tanks", tank_queue, true);
+        add("healers", healer_queue);
+        add("dps", dps_queue);
+        
+        out += "},\"instances\":[";
+        for (int i = 0; i < dungeon_count; i++) {
+            bool used = i < next_instance;
+            out += i > 0 ? ",{" : "{";
+            add("instance", i + 1, true);
+            out += used && dungeon_active[i] ? ",\"status\":\"ACTIVE\"" : ",\"status\":\"EMPTY\"";
+            add("parties_served", used ? parties_served[i] : 0);
+            add("time_served", used ? total_time_served[i] : 0);
+            out += "}";
+        }
+        
+        out += "],\"histograms\":{\"parties_served\":{";
+        bool first = true;
+        for (const auto& [parties, instances] : partiesServedHistogram()) {
+            add(std::to_string(parties).c_str(), instances, first);
+            first = false;
+        }
+        out += "},\"dungeon_seconds\":{";
+        first = true;
+        for (size_t i = 0; i < duration_histogram.size(); i++) {
+            add(std::to_string(min_dungeon_time + i).c_str(), duration_histogram[i], first);
+            first = false;
+        }
+        out += "}}}\n";
+        return out;
+    }
+
+    std::string summaryCsv() {
+        std::string out = "section,key,value\n";
+        auto add = [&out](const std::string& section, const std::string& key, long long value) {
+            out += section + "," + key + "," + std::to_string(value) + "\n";
+        };
+        
+        add("config", "instances", dungeon_count);
+        add("config", "initial_tanks", initial_players[0]);
+        add("config", "initial_healers", initial_players[1]);
+        add("config", "initial_dps", initial_players[2]);
+        add("config", "min_dungeon_time", min_dungeon_time);
+        add("config", "max_dungeon_time", max_dungeon_time);
+        add("config", "producer_interval_ms", producer_interval);
+        add("config", "runtime_seconds", runtime_limit);
+        
+        long long total_parties = 0;
+        long long overall_time = 0;
+        for (int i = 0; i < next_instance; i++) {
+            total_parties += parties_served[i];
+            overall_time += total_time_served[i];
+        }
+        add("totals", "parties_served", total_parties);
+        add("totals", "time_served", overall_time);
+        add("totals", "parties_formed", total_parties_formed);
+        add("totals", "players_added", total_players_added);
+        if (ingestion_guard != nullptr) {
+            IngestionGuard::Counts counts = ingestion_guard->counts();
+            add("totals", "requests_admitted", static_cast<long long>(counts.admitted));
+            add("totals", "requests_rate_limited", static_cast<long long>(counts.limited));
+            add("totals", "requests_duplicate", static_cast<long long>(counts.duplicates));
+            add("totals", "requests_table_full", static_cast<long long>(counts.table_full));
+        }
+        if (account_analytics != nullptr) {
+            add("totals", "unique_accounts", std::llround(account_analytics->report().unique_total));
+        }
+        add("totals", "instance_threads", static_cast<long long>(workers.size()));
+        if (first_party_formed) {
+            add("totals", "time_to_first_party_us",
+                std::chrono::duration_cast<std::chrono::microseconds>(first_party_at - created_at).count());
+        }
+        add("remaining", "tanks", tank_queue);
+        add("remaining", "healers", healer_queue);
+        add("remaining", "dps", dps_queue);
+        
+        for (int i = 0; i < dungeon_count; i++) {
+            bool used = i < next_instance;
+            std::string instance = std::to_string(i + 1);
+            add("instance_active", instance, used && dungeon_active[i] ? 1 : 0);
+            add("instance_parties_served", instance, used ? parties_served[i] : 0);
+            add("instance_time_served", instance, used ? total_time_served[i] : 0);
+        }
+        for (const auto& [parties, instances] : partiesServedHistogram()) {
+            add("histogram_parties_served", std::to_string(parties), instances);
+        }
+        for (size_t i = 0; i < duration_histogram.size(); i++) {
+            add("histogram_dungeon_seconds", std::to_string(min_dungeon_time + i), duration_histogram[i]);
+        }
+        return out;
+    }
+
+    // Call after the run has finished; the instance threads must be joined.
+    bool exportSummary(const std::string& json_path, const std::string& csv_path) {
+        bool ok = true;
+        if (!json_path.empty() && !writeFileAtomically(json_path, summaryJson())) {
+            std::cerr << "Failed to write summary to " << json_path << std::endl;
+            ok = false;
+        }
+        if (!csv_path.empty() && !writeFileAtomically(csv_path, summaryCsv())) {
+            std::cerr << "Failed to write summary to " << csv_path << std::endl;
+            ok = false;
+        }
+        return ok;
+    }
+
+    void setFullStatus(bool enabled) {
+        full_status = enabled;
+    }
+
+    void printDistribution(const std::string& label, const std::vector<int>& values) {
+        InstanceDistribution summary = summarizeInstances(values, dungeon_count);
+        std::cout << label << " - min " << std::fixed << std::setprecision(1) << summary.min
+                  << ", q1 " << summary.q1 << ", median " << summary.median << ", q3 " << summary.q3
+                  << ", max " << summary.max << ", Gini " << std::setprecision(3) << summary.gini << std::endl;
+    }
+
+    void printInstanceRanking(const std::string& label, const std::vector<int>& served,
+                              const std::vector<int>& time_served, bool busiest) {
+        std::cout << label << ":";
+        for (int id : rankInstances(served, summary_rank_count, busiest)) {
+            std::cout << " " << (id + 1) << " (" << served[id] << " parties, " << time_served[id] << "s)";
+        }
+        std::cout << std::endl;
+    }
+
+    void setDashboard(int fps) {
+        dashboard_fps = fps;
+        verbose = fps <= 0;
+    }
+
+    // The work done every two seconds of a real-time run: close forecast
+    // buckets up to now, including ones without arrivals, and start instance
+    // threads ahead of the forecast; report status as an NDJSON event or, if
+    // print_status is set, on the terminal; then sync or checkpoint the state
+    // file.
+    void statusTick(bool print_status) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            forecaster.advanceTo(std::chrono::steady_clock::now());
+            ensureWorkers();
+        }
+        if (events != nullptr) {
+            emitStatusEvent();
+        } else if (print_status) {
+            displayStatus();
+        }
+        maintainState();
+    }
+
+    void runDashboard(std::chrono::steady_clock::time_point start_time, int runtime_seconds) {
+        StatusDashboard dashboard;
+        auto frame_interval = std::chrono::microseconds(1000000 / dashboard_fps);
+        auto next_frame = std::chrono::steady_clock::now();
+        auto next_status = next_frame + std::chrono::seconds(2);
+        
+        while (std::chrono::steady_clock::now() - start_time < std::chrono::seconds(runtime_seconds)) {
+            double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            dashboard.render(snapshot.read(), dungeon_count, elapsed, runtime_seconds);
+            // The status loop in startInstances only starts once the dashboard
+            // returns, so its periodic work runs from here; the dashboard
+            // stands in for the printed status.
+            if (next_frame >= next_status) {
+                statusTick(false);
+                next_status += std::chrono::seconds(2);
+            }
+            next_frame += frame_interval;
+            std::this_thread::sleep_until(next_frame);
+        }
+        dashboard.finish();
+    }
+
+    void ensureWorkers() {
+        int formable_parties = std::min({tank_queue, healer_queue, dps_queue / 3});
+        if (forecast_warmup) {
+            formable_parties = std::max(formable_parties, forecastParties());
+        }
+        while (!shutdown && idle_workers < formable_parties &&
+               static_cast<int>(workers.size()) < dungeon_count) {
+            idle_workers++;
+            workers.emplace_back(&DungeonManager::dungeonInstance, this);
+        }
+    }
+
+    void addPlayersToQueue(int tanks, int healers, int dps) {
+        // Instance threads drain formable parties on shutdown; refusing new
+        // players keeps a busy producer from postponing that forever.
+        if (shutdown) {
+            return;
+        }
+        int added[3]{tanks, healers, dps};
+        long long arrived_us = EventRecord::now();
+        for (int role = 0; role < 3; role++) {
+            if (added[role] > 0 && !store->enqueue(role, added[role], arrived_us) && !ring_full_reported[role]) {
+                static const char* role_names[]{"tank", "healer", "DPS"};
+                ring_full_reported[role] = true;
+                std::cerr << "Queue store: the " << role_names[role] << " ring is full; new arrivals join its newest"
+                          << " batch and their waits are overstated" << std::endl;
+            }
+        }
+        forecaster.recordArrivals(tanks, healers, dps, std::chrono::steady_clock::now());
+        if (queue_timeout.count() > 0) {
+            expireLocked(queue_timeout);
+        }
+        commitState();
+        
+        ensureWorkers();
+        publishSnapshot();
+        
+        if (events != nullptr) {
+            EventRecord record("enqueue", EventRecord::now());
+            record.field("tanks", tanks).field("healers", healers).field("dps", dps)
+                  .field("queued_tanks", tank_queue).field("queued_healers", healer_queue)
+                  .field("queued_dps", dps_queue);
+            events->write(record);
+        }
+        
+        if (verbose) {
+            std::cout << "Producer: Added " << tanks << " tanks, " << healers 
+                      << " healers, " << dps << " DPS to queue." << std::endl;
+        }
+        
+        cv.notify_all();
+    }
+
+    void displayStatus() {
+        std::vector<unsigned char> active_snapshot;
+        std::vector<int> served_snapshot;
+        std::vector<int> time_snapshot;
+        int tanks, healers, dps;
+        double forecast[3];
+        int warm_workers;
+        
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            active_snapshot.assign(&dungeon_active[0], &dungeon_active[0] + next_instance);
+            served_snapshot.assign(&parties_served[0], &parties_served[0] + next_instance);
+            time_snapshot.assign(&total_time_served[0], &total_time_served[0] + next_instance);
+            tanks = tank_queue;
+            healers = healer_queue;
+            dps = dps_queue;
+            for (int role = 0; role < 3; role++) {
+                forecast[role] = forecaster.forecast(role, forecast_horizon);
+            }
+            warm_workers = idle_workers;
+        }
+        
+        int used_instances = static_cast<int>(active_snapshot.size());
+        std::cout << "\n=== Current Instance Status ===" << std::endl;
+        if (full_status) {
+            for (int i = 0; i < dungeon_count; i++) {
+                bool used = i < used_instances;
+                std::cout << "Instance " << (i + 1) << ": " 
+                          << (used && active_snapshot[i] ? "ACTIVE" : "EMPTY") 
+                          << " | Parties served: " << (used ? served_snapshot[i] : 0) 
+                          << " | Total time: " << (used ? time_snapshot[i] : 0) << "s" << std::endl;
+            }
+        } else {
+            int active = static_cast<int>(std::count(active_snapshot.begin(), active_snapshot.end(), 1));
+            std::cout << "Instances: " << dungeon_count << " | Active: " << active
+                      << " | Never used: " << (dungeon_count - used_instances) << std::endl;
+            printDistribution("Parties served per instance", served_snapshot);
+            printDistribution("Time served per instance (s)", time_snapshot);
+            printInstanceRanking("Busiest", served_snapshot, time_snapshot, true);
+            printInstanceRanking("Least busy", served_snapshot, time_snapshot, false);
+        }
+        std::cout << "Players in queue - Tanks: " << tanks
+                  << ", Healers: " << healers
+                  << ", DPS: " << dps << std::endl;
+        std::cout << "Forecast next " << forecast_horizon.count() << "s - Tanks: " << std::fixed
+                  << std::setprecision(1) << forecast[0] << ", Healers: " << forecast[1]
+                  << ", DPS: " << forecast[2] << " | Idle instance threads: " << warm_workers << std::endl;
+        std::cout << "Total parties formed: " << total_parties_formed << std::endl;
+        std::cout << "Total players added: " << total_players_added << std::endl;
+        std::cout << "================================\n" << std::endl;
+    }
+
+    // Engines are not thread-safe, so every thread draws from its own.
+    BulkRandom makeThreadRng() {
+        return BulkRandom(next_seed.fetch_add(0x9e3779b97f4a7c15ULL, std::memory_order_relaxed));
+    }
+
+    void dungeonInstance() {
+        BulkRandom instance_gen = makeThreadRng();
+        
+        while (true) {
+            std::unique_lock<std::mutex> lock(mtx);
+            
+            cv.wait(lock, [this]() { 
+                return canFormParty() || shutdown; 
+            });
+            
+            if (shutdown && !canFormParty()) {
+                break;
+            }
+            
+            if (canFormParty()) {
+                formParty();
+                idle_workers--;
+                int instance_id = acquireInstance();
+                dungeon_active[instance_id] = true;
+                store->startParty(instance_id);
+                commitState();
+                updateTopInstances(instance_id);
+                publishSnapshot();
+                
+                if (events != nullptr) {
+                    EventRecord record("party_formed", EventRecord::now());
+                    record.field("instance", instance_id + 1).field("party", total_parties_formed);
+                    events->write(record);
+                }
+                
+                if (verbose) {
+                    std::cout << "Instance " << (instance_id + 1) 
+                              << ": Party formed! Starting dungeon..." << std::endl;
+                }
+                
+                lock.unlock();
+                
+                int dungeon_time = instance_gen.between(min_dungeon_time, max_dungeon_time);
+                std::this_thread::sleep_for(std::chrono::seconds(dungeon_time));
+                
+                lock.lock();
+                store->finishParty(instance_id, dungeon_time);
+                commitState();
+                if (dungeon_time - min_dungeon_time < static_cast<int>(duration_histogram.size())) {
+                    duration_histogram[dungeon_time - min_dungeon_time]++;
+                }
+                duration_sketch.add(dungeon_time);
+                dungeon_active[instance_id] = false;
+                releaseInstance(instance_id);
+                idle_workers++;
+                publishSnapshot();
+                
+                if (events != nullptr) {
+                    EventRecord record("dungeon_completed", EventRecord::now());
+                    record.field("instance", instance_id + 1).field("duration_s", dungeon_time);
+                    events->write(record);
+                }
+                
+                if (verbose) {
+                    std::cout << "Instance " << (instance_id + 1) 
+                              << ": Dungeon completed in " << dungeon_time << " seconds!" << std::endl;
+                }
+                
+                cv.notify_all();
+            }
+        }
+    }
+
+    void playerProducer(int interval_ms, int max_runtime_seconds) {
+        BulkRandom gen = makeThreadRng();
+        BulkRandom account_gen = makeThreadRng();
+        AccountAnalytics::Writer* account_stats = accountStatsWriter();
+        
+        auto start_time = std::chrono::steady_clock::now();
+        
+        while (true) {
+            auto current_time = std::chrono::steady_clock::now();
+            auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(current_time - start_time).count();
+            
+            if (elapsed >= max_runtime_seconds) {
+                if (verbose) {
+                    std::cout << "Reached maximum runtime. Stopping producer." << std::endl;
+                }
+                break;
+            }
+            
+            int tanks_to_add = 0;
+            int healers_to_add = 0;
+            int dps_to_add = 0;
+            
+            int players_to_add = gen.between(1, 3);
+            for (int i = 0; i < players_to_add; i++) {
+                int role = static_cast<int>(gen.below(3));
+                if (!admitPlayer(account_gen, account_stats)) {
+                    continue;
+                }
+                switch (role) {
+                    case 0: tanks_to_add++; break;
+                    case 1: healers_to_add++; break;
+                    case 2: dps_to_add++; break;
+                }
+            }
+            
+            dps_to_add += admitSpam(account_stats);
+            
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                addPlayersToQueue(tanks_to_add, healers_to_add, dps_to_add);
+            }
+            
+            std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+        }
+    }
+
+    void setIngestionGuard(IngestionGuard* guard, uint64_t accounts, int spam_requests_per_tick) {
+        ingestion_guard = guard;
+        account_count = accounts;
+        spam_rate = spam_requests_per_tick;
+    }
+
+    void setAccountAnalytics(AccountAnalytics* analytics, uint64_t accounts, int spam_requests_per_tick) {
+        account_analytics = analytics;
+        account_count = accounts;
+        spam_rate = spam_requests_per_tick;
+    }
+    
+    AccountAnalytics::Writer* accountStatsWriter() {
+        return account_analytics != nullptr ? &account_analytics->writer() : nullptr;
+    }
+    
+    // Draws the requesting account for one enqueue, records it in the
+    // calling thread's account statistics and asks the guard, if any,
+    // whether to accept it.
+    bool admitPlayer(BulkRandom& account_gen, AccountAnalytics::Writer* stats) {
+        if (ingestion_guard == nullptr && stats == nullptr) {
+            return true;
+        }
+        uint64_t account = 1 + account_gen() % account_count;
+        if (stats != nullptr) {
+            stats->record(account, AccountAnalytics::currentHour());
+        }
+        return ingestion_guard == nullptr ||
+               ingestion_guard->admit(account, ingestion_guard->nowMs()) == IngestionGuard::Admitted;
+    }
+
+    // One misbehaving client hammering enqueue with the same account.
+    int admitSpam(AccountAnalytics::Writer* stats) {
+        int admitted = 0;
+        if (ingestion_guard == nullptr && stats == nullptr) {
+            return 0;
+        }
+        for (int i = 0; i < spam_rate; i++) {
+            if (stats != nullptr) {
+                stats->record(account_count + 1, AccountAnalytics::currentHour());
+            }
+            admitted += ingestion_guard == nullptr ||
+                        ingestion_guard->admit(account_count + 1, ingestion_guard->nowMs()) == IngestionGuard::Admitted;
+        }
+        return admitted;
+    }
+
+    void setScenario(const ScenarioSchedule* schedule) {
+        scenario = schedule;
+    }
+
+    // Replays the scenario in real time. Arrivals and events that fall due
+    // within the same tick are applied under a single lock acquisition.
+    void scenarioProducer() {
+        const auto tick = std::chrono::milliseconds(50);
+        BulkRandom scenario_gen = makeThreadRng();
+        AccountAnalytics::Writer* account_stats = accountStatsWriter();
+        double cumulative = 0.0;
+        size_t segment = 0;
+        size_t next_event = 0;
+        int capacity = dungeon_count;
+        int offline = 0;
+        double next_arrival = scenario->nextArrival(cumulative, segment, scenario_gen.exponential());
+        auto start_time = std::chrono::steady_clock::now();
+        auto last_wake = start_time - tick;
+        
+        while (true) {
+            double next_time = next_arrival;
+            if (next_event < scenario->events.size()) {
+                next_time = std::min(next_time, scenario->events[next_event].time);
+            }
+            if (next_time >= scenario->duration) {
+                break;
+            }
+            auto due = start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(next_time));
+            last_wake = std::max(due, last_wake + tick);
+            std::this_thread::sleep_until(last_wake);
+            double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            
+            int added[3]{0, 0, 0};
+            bool capacity_changed = false;
+            while (next_event < scenario->events.size() && scenario->events[next_event].time <= now) {
+                const ScenarioEvent& event = scenario->events[next_event++];
+                if (event.kind == ScenarioEvent::Burst) {
+                    for (int i = 0; i < event.value; i++) {
+                        int role = scenario->roleAt(event.time, scenario_gen.unit());
+                        if (admitPlayer(scenario_gen, account_stats)) {
+                            added[role]++;
+                        }
+                    }
+                } else {
+                    if (event.kind == ScenarioEvent::Capacity) {
+                        capacity = event.value;
+                    } else {
+                        offline += event.value;
+                    }
+                    capacity_changed = true;
+                }
+            }
+            while (next_arrival <= now && next_arrival < scenario->duration) {
+                int role = scenario->pickRole(segment, scenario_gen.unit());
+                if (admitPlayer(scenario_gen, account_stats)) {
+                    added[role]++;
+                }
+                next_arrival = scenario->nextArrival(cumulative, segment, scenario_gen.exponential());
+            }
+            added[2] += admitSpam(account_stats);
+            
+            std::lock_guard<std::mutex> lock(mtx);
+            if (capacity_changed) {
+                instance_limit = std::clamp(capacity - offline, 0, dungeon_count);
+                if (verbose) {
+                    std::cout << "Scenario: " << instance_limit << " instance(s) available." << std::endl;
+                }
+                cv.notify_all();
+            }
+            if (added[0] + added[1] + added[2] > 0) {
+                addPlayersToQueue(added[0], added[1], added[2]);
+            }
+        }
+    }
+
+    void startInstances(int t1, int t2, int producer_interval_ms = 3000, int max_runtime_seconds = 30) {
+        if (scenario != nullptr) {
+            max_runtime_seconds = static_cast<int>(std::ceil(scenario->duration));
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            min_dungeon_time = t1;
+            max_dungeon_time = t2;
+            producer_interval = producer_interval_ms;
+            runtime_limit = max_runtime_seconds;
+            duration_histogram.assign(t2 - t1 + 1, 0);
+            store->setDungeonTimes(t1, t2);
+            ensureWorkers();
+            publishSnapshot();
+        }
+        
+        std::thread producer_thread;
+        if (scenario != nullptr) {
+            producer_thread = std::thread(&DungeonManager::scenarioProducer, this);
+        } else {
+            producer_thread = std::thread(&DungeonManager::playerProducer, this, producer_interval_ms, max_runtime_seconds);
+        }
+        
+        auto start_time = std::chrono::steady_clock::now();
+        if (dashboard_fps > 0) {
+            runDashboard(start_time, max_runtime_seconds);
+        }
+        while (std::chrono::steady_clock::now() - start_time < std::chrono::seconds(max_runtime_seconds)) {
+            statusTick(true);
+            std::this_thread::sleep_for(std::chrono::seconds(2));
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            shutdown = true;
+            cv.notify_all();
+        }
+        
+        producer_thread.join();
+        
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        maintainState(true);
+        
+        displayFinalSummary();
+    }
+
+    void runMatchingBenchmark(int parties, int producers, bool json_output) {
+        verbose = false;
+        min_dungeon_time = 0;
+        max_dungeon_time = 0;
+        
+        PerfCounterGroup counters;
+        counters.start();
+        auto start_time = std::chrono::steady_clock::now();
+        
+        std::vector<std::thread> producer_threads;
+        for (int p = 0; p < producers; p++) {
+            int batches = parties / producers + (p < parties % producers ? 1 : 0);
+            producer_threads.emplace_back([this, batches]() {
+                for (int i = 0; i < batches; i++) {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    addPlayersToQueue(1, 1, 3);
+                }
+            });
+        }
+        
+        for (auto& producer : producer_threads) {
+            producer.join();
+        }
+        
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this, parties]() {
+                return total_parties_formed >= parties && idle_workers == static_cast<int>(workers.size());
+            });
+            shutdown = true;
+            cv.notify_all();
+        }
+        
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        
+        unsigned long long events_written = 0;
+        if (events != nullptr) {
+            events->stop();
+            events_written = events->eventsWritten();
+        }
+        
+        auto end_time = std::chrono::steady_clock::now();
+        counters.stop();
+        
+        double elapsed_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+        if (json_output) {
+            std::cout << "{\"parties\":" << total_parties_formed
+                      << ",\"instances\":" << dungeon_count
+                      << ",\"producers\":" << producers
+                      << ",\"instance_threads\":" << workers.size()
+                      << std::fixed << std::setprecision(3)
+                      << ",\"elapsed_ms\":" << elapsed_ms
+                      << ",\"parties_per_sec\":" << total_parties_formed * 1000.0 / elapsed_ms
+                      << ",\"events\":" << events_written
+                      << ",\"events_per_sec\":" << events_written * 1000.0 / elapsed_ms
+                      << ",\"counters\":";
+            counters.reportJson(std::cout);
+            std::cout << "}" << std::endl;
+            return;
+        }
+        
+        std::cout << "\n=== MATCHING BENCHMARK ===" << std::endl;
+        std::cout << "Instances: " << dungeon_count << " | Producers: " << producers
+                  << " | Instance threads: " << workers.size() << std::endl;
+        std::cout << "Parties formed: " << total_parties_formed << " in " << std::fixed
+                  << std::setprecision(2) << elapsed_ms << " ms ("
+                  << std::setprecision(0) << total_parties_formed * 1000.0 / elapsed_ms
+                  << " parties/s)" << std::endl;
+        if (events != nullptr) {
+            std::cout << "Events written: " << events_written << " ("
+                      << events_written * 1000.0 / elapsed_ms << " events/s)" << std::endl;
+        }
+        counters.report(std::cout, total_parties_formed, "party");
+    }
+
+    void displayFinalSummary() {
+        std::cout << "\n\n=== FINAL SUMMARY ===" << std::endl;
+        std::cout << std::setw(12) << "Instance" 
+                  << std::setw(15) << "Status" 
+                  << std::setw(18) << "Parties Served" 
+                  << std::setw(16) << "Total Time" << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+        
+        int total_parties = 0;
+        int overall_time = 0;
+        auto printRow = [this](int i) {
+            std::cout << std::setw(10) << (i + 1) 
+                      << std::setw(15) << (dungeon_active[i] ? "ACTIVE" : "EMPTY")
+                      << std::setw(15) << parties_served[i] 
+                      << std::setw(15) << total_time_served[i] << "s" << std::endl;
+        };
+        
+        int listed = full_status ? dungeon_count : next_instance;
+        std::vector<int> served(&parties_served[0], &parties_served[0] + listed);
+        std::vector<int> time_served(&total_time_served[0], &total_time_served[0] + listed);
+        for (int i = 0; i < listed; i++) {
+            total_parties += served[i];
+            overall_time += time_served[i];
+        }
+        
+        if (full_status || listed <= 2 * summary_rank_count) {
+            for (int i = 0; i < listed; i++) {
+                printRow(i);
+            }
+        } else {
+            for (int id : rankInstances(served, summary_rank_count, true)) {
+                printRow(id);
+            }
+            std::cout << std::setw(10) << "..." << std::endl;
+            std::vector<int> least_busy = rankInstances(served, summary_rank_count, false);
+            for (auto it = least_busy.rbegin(); it != least_busy.rend(); ++it) {
+                printRow(*it);
+            }
+        }
+        
+        std::cout << std::string(60, '-') << std::endl;
+        std::cout << std::setw(25) << "TOTAL" 
+                  << std::setw(15) << total_parties 
+                  << std::setw(15) << overall_time << "s" << std::endl;
+        if (!full_status) {
+            if (listed < dungeon_count) {
+                std::cout << (dungeon_count - listed) << " instance(s) never used" << std::endl;
+            }
+            printDistribution("Parties served per instance", served);
+            printDistribution("Time served per instance (s)", time_served);
+        }
+        std::cout << "Remaining players - Tanks: " << tank_queue
+                  << ", Healers: " << healer_queue
+                  << ", DPS: " << dps_queue << std::endl;
+        std::cout << "Total players added by producer: " << total_players_added << std::endl;
+        std::cout << "Total parties formed: " << total_parties_formed << std::endl;
+        std::cout << "Instance threads started: " << workers.size() << " of " << dungeon_count << std::endl;
+        if (!wait_sketches[0].empty() || !wait_sketches[1].empty() || !wait_sketches[2].empty()) {
+            static const char* role_names[]{"Tanks", "Healers", "DPS"};
+            std::cout << "Matched wait p50 / p99 (DDSketch, 1% relative error) -" << std::fixed << std::setprecision(2);
+            for (int role = 0; role < 3; role++) {
+                std::cout << (role > 0 ? ", " : " ") << role_names[role] << ": " << wait_sketches[role].quantile(0.5)
+                          << "s / " << wait_sketches[role].quantile(0.99) << "s";
+            }
+            std::cout << std::endl;
+        }
+        if (queue_timeout.count() > 0) {
+            std::cout << "Players expired after " << queue_timeout.count() << "s - Tanks: " << players_expired[0]
+                      << ", Healers: " << players_expired[1] << ", DPS: " << players_expired[2] << std::endl;
+        }
+        if (players_merged[0] + players_merged[1] + players_merged[2] > 0) {
+            std::cout << "Players merged into a full queue ring - Tanks: " << players_merged[0]
+                      << ", Healers: " << players_merged[1] << ", DPS: " << players_merged[2] << std::endl;
+        }
+        if (ingestion_guard != nullptr) {
+            IngestionGuard::Counts counts = ingestion_guard->counts();
+            std::cout << "Enqueue requests - admitted: " << counts.admitted << ", rate limited: " << counts.limited
+                      << ", duplicates: " << counts.duplicates << ", refused with the account table full: "
+                      << counts.table_full << std::endl;
+        }
+        if (account_analytics != nullptr) {
+            AccountAnalytics::print(account_analytics->report());
+        }
+        if (forecaster.scoredBuckets() > 0) {
+            std::cout << "Forecast error over " << forecaster.scoredBuckets() << " buckets (MAE per bucket / WAPE) - "
+                      << std::fixed << std::setprecision(2)
+                      << "Tanks: " << forecaster.meanAbsoluteError(0) << " / " << forecaster.weightedPercentError(0) << "%, "
+                      << "Healers: " << forecaster.meanAbsoluteError(1) << " / " << forecaster.weightedPercentError(1) << "%, "
+                      << "DPS: " << forecaster.meanAbsoluteError(2) << " / " << forecaster.weightedPercentError(2) << "%"
+                      << std::endl;
+        }
+        if (first_party_formed) {
+            std::cout << "Time to first party: " << std::fixed << std::setprecision(3)
+                      << std::chrono::duration<double, std::milli>(first_party_at - created_at).count()
+                      << " ms" << std::endl;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,669 @@
+#ifndef QUEUE_STORE_H
+#define QUEUE_STORE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "columnarLog.h"
+#include "instanceTables.h"
+
+/*
+ * Queue state of the real-time DungeonManager, optionally persisted to a
+ * state file with a redo journal (--state-file).
+ */
+
+// Queue counters, arrival batches and the instance table of a DungeonManager,
+// laid out as one flat image that refers to its arrays by offset, so it works
+// in any mapping. Without a state file the image is anonymous memory.
+//
+// With a state file the file holds two header slots and two copies of the
+// image. Every change is also appended to a redo journal (PATH.journal) in
+// commit groups of fixed-size, CRC-checked records. A checkpoint syncs the
+// journal, writes the live parts of the image into the older copy, then
+// writes the header slot that points at it and empties the journal. If a
+// crash tears any of those writes, the other header and copy are still valid
+// and the journal still covers everything since that checkpoint. Restoring
+// maps the newest copy privately and replays the committed journal groups,
+// so nothing is parsed or rebuilt; a torn journal tail is dropped.
+class QueueStore {
+public:
+    struct StoredBatch {
+        int64_t arrived_us;
+        int32_t count;
+        int32_t reserved;
+    };
+    
+    struct Image {
+        uint32_t instance_count;
+        uint32_t batch_capacity;
+        int32_t min_time;
+        int32_t max_time;
+        int32_t initial_players[3];
+        int32_t queued[3];
+        int32_t next_instance;
+        // Read by status threads without the lock, through std::atomic_ref.
+        int32_t parties_formed;
+        int32_t players_added;
+        int32_t reserved;
+        long long added_by_role[3];
+        long long cancelled[3];
+        long long expired[3];
+        long long merged[3];
+        uint64_t head[3];
+        uint64_t tail[3];
+        uint64_t ring_offset[3];
+        uint64_t parties_served_offset;
+        uint64_t time_served_offset;
+    };
+    
+    struct RestoreStats {
+        uint64_t generation{0};
+        uint64_t replayed{0};
+        uint64_t dropped_bytes{0};
+    };
+
+private:
+    struct FileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t crc;
+        uint64_t generation;
+        uint64_t checkpoint_seq;
+        uint64_t image_bytes;
+        uint32_t active_copy;
+        uint32_t reserved;
+    };
+    
+    enum JournalType : uint8_t {
+        JOURNAL_ENQUEUE = 1,
+        JOURNAL_REMOVE = 2,
+        JOURNAL_PARTY_START = 3,
+        JOURNAL_PARTY_END = 4
+    };
+    
+    struct JournalRecord {
+        uint64_t seq;
+        int64_t value;
+        uint32_t a;
+        uint32_t b;
+        uint8_t type;
+        uint8_t commit;
+        uint16_t reserved;
+        uint32_t crc;
+    };
+    
+    static constexpr char state_magic[8]{'D', 'M', 'S', 'T', 'A', 'T', 'E', '1'};
+    static constexpr uint32_t state_version = 3;
+    // Header slots sit in separate 512-byte sectors so one torn sector
+    // cannot damage both.
+    static constexpr off_t header_slot_bytes = 512;
+    static constexpr off_t images_offset = 4096;
+    
+    char* base{nullptr};
+    size_t image_bytes{0};
+    size_t mapped_bytes{0};
+    PageMode page_mode{PageMode::normal};
+    uint64_t ring_mask{0};
+    
+    int state_fd{-1};
+    int journal_fd{-1};
+    std::string journal_path;
+    std::string journal_error;
+    std::vector<JournalRecord> pending;
+    uint64_t next_seq{1};
+    uint64_t generation{0};
+    uint32_t active_copy{1};
+    uint64_t journal_bytes{0};
+    bool replaying{false};
+    
+    static uint32_t crc32(const void* data, size_t size) {
+        static const std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> entries{};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t value = i;
+                for (int bit = 0; bit < 8; bit++) {
+                    value = (value & 1) ? 0xedb88320u ^ (value >> 1) : value >> 1;
+                }
+                entries[i] = value;
+            }
+            return entries;
+        }();
+        uint32_t crc = 0xffffffffu;
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+    
+    static size_t pageAlign(size_t bytes) {
+        return (bytes + 4095) & ~size_t{4095};
+    }
+    
+    // Every region is followed by one spare page. Otherwise, on huge pages,
+    // the same index of the two instance arrays (or of two rings) shares
+    // its physical address bits below 2 MiB, and paired updates conflict in
+    // the caches and DRAM banks.
+    static size_t layoutBytes(uint32_t instances, uint32_t capacity, Image* image) {
+        size_t offset = pageAlign(sizeof(Image));
+        for (int role = 0; role < 3; role++) {
+            if (image != nullptr) {
+                image->ring_offset[role] = offset;
+            }
+            offset = pageAlign(offset + static_cast<size_t>(capacity) * sizeof(StoredBatch)) + 4096;
+        }
+        if (image != nullptr) {
+            image->parties_served_offset = offset;
+        }
+        offset = pageAlign(offset + static_cast<size_t>(instances) * sizeof(int)) + 4096;
+        if (image != nullptr) {
+            image->time_served_offset = offset;
+        }
+        return pageAlign(offset + static_cast<size_t>(instances) * sizeof(int));
+    }
+    
+    off_t copyOffset(uint32_t copy) const {
+        return images_offset + static_cast<off_t>(copy) * static_cast<off_t>(image_bytes);
+    }
+    
+    StoredBatch* ring(int role) {
+        return reinterpret_cast<StoredBatch*>(base + image().ring_offset[role]);
+    }
+    
+    void append(JournalType type, uint32_t a, uint32_t b, int64_t value) {
+        if (journal_fd < 0 || replaying) {
+            return;
+        }
+        JournalRecord record{};
+        record.seq = next_seq++;
+        record.value = value;
+        record.a = a;
+        record.b = b;
+        record.type = type;
+        pending.push_back(record);
+    }
+    
+    static bool writeAll(int fd, const void* data, size_t size, off_t offset) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = offset >= 0 ? ::pwrite(fd, bytes, size, offset) : ::write(fd, bytes, size);
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+            if (offset >= 0) {
+                offset += written;
+            }
+        }
+        return true;
+    }
+    
+    bool fail(std::string& error, const std::string& what) {
+        error = what + ": " + std::strerror(errno);
+        return false;
+    }
+    
+    bool apply(const JournalRecord& record) {
+        const Image& current = image();
+        switch (record.type) {
+            case JOURNAL_ENQUEUE:
+                if (record.a > 2) {
+                    return false;
+                }
+                enqueue(static_cast<int>(record.a), static_cast<int>(record.b), record.value);
+                return true;
+            case JOURNAL_REMOVE:
+                if (record.a > 2) {
+                    return false;
+                }
+                remove(static_cast<int>(record.a), static_cast<int>(record.b), (record.value >> 8) & 1,
+                       static_cast<ColumnarKind>(record.value & 0xff), [](int64_t, int) {});
+                return true;
+            case JOURNAL_PARTY_START:
+            case JOURNAL_PARTY_END:
+                if (record.a >= current.instance_count) {
+                    return false;
+                }
+                if (record.type == JOURNAL_PARTY_START) {
+                    startParty(static_cast<int>(record.a));
+                } else {
+                    finishParty(static_cast<int>(record.a), static_cast<int>(record.b));
+                }
+                return true;
+        }
+        return false;
+    }
+    
+    // Replays committed groups newer than checkpoint_seq and cuts the journal
+    // after the last one, so a torn tail cannot hide later appends.
+    bool replayJournal(uint64_t checkpoint_seq, RestoreStats& stats, std::string& error) {
+        struct stat info;
+        if (::fstat(journal_fd, &info) != 0) {
+            return fail(error, "Cannot stat " + journal_path);
+        }
+        std::vector<JournalRecord> records(static_cast<size_t>(info.st_size) / sizeof(JournalRecord));
+        if (!records.empty() && ::pread(journal_fd, records.data(), records.size() * sizeof(JournalRecord), 0) !=
+                                    static_cast<ssize_t>(records.size() * sizeof(JournalRecord))) {
+            return fail(error, "Cannot read " + journal_path);
+        }
+        
+        next_seq = checkpoint_seq + 1;
+        size_t group_start = 0;
+        size_t valid_records = 0;
+        replaying = true;
+        for (size_t i = 0; i < records.size(); i++) {
+            JournalRecord record = records[i];
+            uint32_t crc = record.crc;
+            record.crc = 0;
+            if (crc32(&record, sizeof(record)) != crc) {
+                break;
+            }
+            if (record.seq <= checkpoint_seq) {
+                group_start = valid_records = i + 1;
+                continue;
+            }
+            if (record.seq != next_seq + (i - group_start)) {
+                break;
+            }
+            if (record.commit) {
+                for (size_t j = group_start; j <= i; j++) {
+                    if (!apply(records[j])) {
+                        replaying = false;
+                        error = journal_path + " holds an invalid record";
+                        return false;
+                    }
+                }
+                stats.replayed += i + 1 - group_start;
+                next_seq = record.seq + 1;
+                group_start = valid_records = i + 1;
+            }
+        }
+        replaying = false;
+        
+        off_t valid_bytes = static_cast<off_t>(valid_records * sizeof(JournalRecord));
+        stats.dropped_bytes = static_cast<uint64_t>(info.st_size - valid_bytes);
+        if (valid_bytes != info.st_size && ::ftruncate(journal_fd, valid_bytes) != 0) {
+            return fail(error, "Cannot truncate " + journal_path);
+        }
+        journal_bytes = static_cast<uint64_t>(valid_bytes);
+        return true;
+    }
+
+public:
+    // An anonymous image; batch_capacity must be a power of two. A restored
+    // image is a private file mapping and always uses normal pages.
+    QueueStore(uint32_t instances, uint32_t capacity = 1 << 18, PageMode mode = PageMode::normal) {
+        Image layout{};
+        image_bytes = layoutBytes(instances, capacity, &layout);
+        void* mapping = mapArena(image_bytes, mode, mapped_bytes);
+        if (mapping == nullptr) {
+            throw std::bad_alloc();
+        }
+        page_mode = mode;
+        base = static_cast<char*>(mapping);
+        layout.instance_count = instances;
+        layout.batch_capacity = capacity;
+        std::memcpy(base, &layout, sizeof(layout));
+        ring_mask = capacity - 1;
+    }
+    
+    ~QueueStore() {
+        if (base != nullptr) {
+            munmap(base, mapped_bytes);
+        }
+        if (state_fd >= 0) {
+            ::close(state_fd);
+        }
+        if (journal_fd >= 0) {
+            ::close(journal_fd);
+        }
+    }
+    
+    QueueStore(const QueueStore&) = delete;
+    QueueStore& operator=(const QueueStore&) = delete;
+    
+    // Maps the newest valid image in path and replays its journal. Returns
+    // nullptr with an empty error if there is no state file yet.
+    static std::unique_ptr<QueueStore> restore(const std::string& path, RestoreStats& stats, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) {
+            if (errno != ENOENT) {
+                error = "Cannot open " + path + ": " + std::strerror(errno);
+            }
+            return nullptr;
+        }
+        std::unique_ptr<QueueStore> store(new QueueStore());
+        store->state_fd = fd;
+        
+        FileHeader best{};
+        bool found = false;
+        for (int slot = 0; slot < 2; slot++) {
+            FileHeader header;
+            if (::pread(fd, &header, sizeof(header), slot * header_slot_bytes) != sizeof(header)) {
+                continue;
+            }
+            uint32_t crc = header.crc;
+            header.crc = 0;
+            if (std::memcmp(header.magic, state_magic, sizeof(state_magic)) != 0 || header.version != state_version ||
+                crc32(&header, sizeof(header)) != crc || header.active_copy > 1) {
+                continue;
+            }
+            if (!found || header.generation > best.generation) {
+                best = header;
+                found = true;
+            }
+        }
+        struct stat info;
+        store->image_bytes = best.image_bytes;
+        if (!found || ::fstat(fd, &info) != 0 ||
+            info.st_size < store->copyOffset(best.active_copy) + static_cast<off_t>(best.image_bytes)) {
+            error = path + " has no valid state header or is truncated";
+            return nullptr;
+        }
+        
+        void* mapping = mmap(nullptr, best.image_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                             store->copyOffset(best.active_copy));
+        if (mapping == MAP_FAILED) {
+            error = "Cannot map " + path + ": " + std::strerror(errno);
+            store->image_bytes = 0;
+            return nullptr;
+        }
+        store->base = static_cast<char*>(mapping);
+        store->mapped_bytes = best.image_bytes;
+        store->generation = best.generation;
+        store->active_copy = best.active_copy;
+        stats.generation = best.generation;
+        
+        Image expected{};
+        const Image& image = store->image();
+        uint32_t capacity = image.batch_capacity;
+        bool valid = capacity > 0 && (capacity & (capacity - 1)) == 0 &&
+                     layoutBytes(image.instance_count, capacity, &expected) == best.image_bytes &&
+                     image.next_instance >= 0 && static_cast<uint32_t>(image.next_instance) <= image.instance_count &&
+                     image.parties_served_offset == expected.parties_served_offset &&
+                     image.time_served_offset == expected.time_served_offset;
+        for (int role = 0; role < 3 && valid; role++) {
+            valid = image.ring_offset[role] == expected.ring_offset[role] && image.head[role] <= image.tail[role] &&
+                    image.tail[role] - image.head[role] <= capacity;
+        }
+        if (!valid) {
+            error = path + " holds an inconsistent image";
+            return nullptr;
+        }
+        store->ring_mask = capacity - 1;
+        
+        store->journal_path = path + ".journal";
+        store->journal_fd = ::open(store->journal_path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (store->journal_fd < 0) {
+            error = "Cannot open " + store->journal_path + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        if (!store->replayJournal(best.checkpoint_seq, stats, error)) {
+            return nullptr;
+        }
+        return store;
+    }
+    
+    // Starts persisting an anonymous image to path (replacing any file there)
+    // with an initial checkpoint.
+    bool createFile(const std::string& path, std::string& error) {
+        state_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (state_fd < 0) {
+            return fail(error, "Cannot create " + path);
+        }
+        if (::ftruncate(state_fd, images_offset + 2 * static_cast<off_t>(image_bytes)) != 0) {
+            return fail(error, "Cannot size " + path);
+        }
+        journal_path = path + ".journal";
+        journal_fd = ::open(journal_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (journal_fd < 0) {
+            return fail(error, "Cannot create " + journal_path);
+        }
+        return checkpoint(error);
+    }
+    
+    bool persistent() const {
+        return journal_fd >= 0;
+    }
+    
+    Image& image() {
+        return *reinterpret_cast<Image*>(base);
+    }
+    
+    int* partiesServed() {
+        return reinterpret_cast<int*>(base + image().parties_served_offset);
+    }
+    
+    int* timeServed() {
+        return reinterpret_cast<int*>(base + image().time_served_offset);
+    }
+    
+    size_t batchCount(int role) {
+        return static_cast<size_t>(image().tail[role] - image().head[role]);
+    }
+    
+    // The i-th oldest queued batch of a role.
+    const StoredBatch& batch(int role, size_t i) {
+        return ring(role)[(image().head[role] + i) & ring_mask];
+    }
+    
+    uint64_t journalBytes() const {
+        return journal_bytes;
+    }
+    
+    size_t imageBytes() const {
+        return image_bytes;
+    }
+    
+    PageMode pageMode() const {
+        return page_mode;
+    }
+    
+    const void* imageAddress() const {
+        return base;
+    }
+    
+    // Touches [offset, offset + length) of the image so later accesses do not
+    // fault; false if the kernel cannot populate ahead of time.
+    bool prefault(size_t offset, size_t length) {
+#ifdef MADV_POPULATE_WRITE
+        size_t begin = offset & ~size_t{4095};
+        size_t end = std::min(image_bytes, offset + length);
+        if (begin >= end) {
+            return true;
+        }
+        return madvise(base + begin, end - begin, MADV_POPULATE_WRITE) == 0;
+#else
+        return false;
+#endif
+    }
+    
+    // Players present before the run starts; not journaled because a new
+    // state file is checkpointed right after.
+    void seed(int role, int count, int64_t arrived_us) {
+        Image& state = image();
+        state.initial_players[role] = count;
+        state.queued[role] += count;
+        state.added_by_role[role] += count;
+        if (count > 0) {
+            ring(role)[state.tail[role]++ & ring_mask] = {arrived_us, count, 0};
+        }
+    }
+    
+    void setDungeonTimes(int min_time, int max_time) {
+        image().min_time = min_time;
+        image().max_time = max_time;
+    }
+    
+    // When a role's ring is full the players join its newest batch and take
+    // its earlier arrival time, overstating their waits; they are counted in
+    // merged and false is returned.
+    bool enqueue(int role, int count, int64_t arrived_us) {
+        Image& state = image();
+        bool stored = state.tail[role] - state.head[role] < state.batch_capacity;
+        if (stored) {
+            ring(role)[state.tail[role]++ & ring_mask] = {arrived_us, count, 0};
+        } else {
+            ring(role)[(state.tail[role] - 1) & ring_mask].count += count;
+            state.merged[role] += count;
+        }
+        state.queued[role] += count;
+        state.added_by_role[role] += count;
+        std::atomic_ref<int32_t>(state.players_added).fetch_add(count, std::memory_order_relaxed);
+        append(JOURNAL_ENQUEUE, role, count, arrived_us);
+        return stored;
+    }
+    
+    // Removes up to count of the oldest or newest players of a role, calling
+    // on_batch(arrived_us, taken) for each batch they come from.
+    template <typename F>
+    int remove(int role, int count, bool oldest_first, ColumnarKind kind, F&& on_batch) {
+        Image& state = image();
+        int removed = 0;
+        while (removed < count && state.head[role] < state.tail[role]) {
+            uint64_t position = oldest_first ? state.head[role] : state.tail[role] - 1;
+            StoredBatch& stored = ring(role)[position & ring_mask];
+            int taken = std::min(stored.count, count - removed);
+            stored.count -= taken;
+            removed += taken;
+            on_batch(stored.arrived_us, taken);
+            if (stored.count == 0) {
+                if (oldest_first) {
+                    state.head[role]++;
+                } else {
+                    state.tail[role]--;
+                }
+            }
+        }
+        state.queued[role] -= removed;
+        if (kind == COLUMNAR_CANCELLED) {
+            state.cancelled[role] += removed;
+        } else if (kind == COLUMNAR_EXPIRED) {
+            state.expired[role] += removed;
+        }
+        if (removed > 0) {
+            append(JOURNAL_REMOVE, role, removed, (oldest_first ? 1 << 8 : 0) | kind);
+        }
+        return removed;
+    }
+    
+    void startParty(int instance) {
+        Image& state = image();
+        std::atomic_ref<int32_t>(state.parties_formed).fetch_add(1, std::memory_order_relaxed);
+        partiesServed()[instance]++;
+        state.next_instance = std::max(state.next_instance, instance + 1);
+        append(JOURNAL_PARTY_START, instance, 0, 0);
+    }
+    
+    void finishParty(int instance, int seconds) {
+        timeServed()[instance] += seconds;
+        append(JOURNAL_PARTY_END, instance, seconds, 0);
+    }
+    
+    // Appends the changes since the last commit to the journal as one group.
+    // The write reaches the page cache, so it survives a process crash;
+    // sync() or checkpoint() make it survive power loss. A failed or short
+    // write is cut back off the journal and journaling stops, since every
+    // later group would depend on the lost one; journalError() says why.
+    bool commit() {
+        if (pending.empty()) {
+            return true;
+        }
+        pending.back().commit = 1;
+        for (auto& record : pending) {
+            record.crc = crc32(&record, sizeof(record));
+        }
+        size_t bytes = pending.size() * sizeof(JournalRecord);
+        bool ok = writeAll(journal_fd, pending.data(), bytes, -1);
+        pending.clear();
+        if (ok) {
+            journal_bytes += bytes;
+            return true;
+        }
+        fail(journal_error, "Cannot append to " + journal_path);
+        if (::ftruncate(journal_fd, static_cast<off_t>(journal_bytes)) != 0) {
+            journal_error += std::string("; cannot truncate it: ") + std::strerror(errno);
+        }
+        ::close(journal_fd);
+        journal_fd = -1;
+        return false;
+    }
+    
+    const std::string& journalError() const {
+        return journal_error;
+    }
+    
+    bool sync() {
+        return !persistent() || (commit() && ::fdatasync(journal_fd) == 0);
+    }
+    
+    bool checkpoint(std::string& error) {
+        if (!commit() || ::fdatasync(journal_fd) != 0) {
+            return fail(error, "Cannot sync " + journal_path);
+        }
+        
+        Image& state = image();
+        uint32_t target = 1 - active_copy;
+        off_t copy = copyOffset(target);
+        bool ok = writeAll(state_fd, base, sizeof(Image), copy);
+        for (int role = 0; role < 3 && ok; role++) {
+            uint64_t position = state.head[role];
+            while (ok && position < state.tail[role]) {
+                uint64_t index = position & ring_mask;
+                uint64_t run = std::min(state.tail[role] - position, state.batch_capacity - index);
+                ok = writeAll(state_fd, &ring(role)[index], run * sizeof(StoredBatch),
+                              copy + static_cast<off_t>(state.ring_offset[role] + index * sizeof(StoredBatch)));
+                position += run;
+            }
+        }
+        size_t used = static_cast<size_t>(state.next_instance) * sizeof(int);
+        ok = ok && writeAll(state_fd, partiesServed(), used, copy + static_cast<off_t>(state.parties_served_offset)) &&
+             writeAll(state_fd, timeServed(), used, copy + static_cast<off_t>(state.time_served_offset));
+        if (!ok || ::fdatasync(state_fd) != 0) {
+            return fail(error, "Cannot write checkpoint");
+        }
+        
+        FileHeader header{};
+        std::memcpy(header.magic, state_magic, sizeof(state_magic));
+        header.version = state_version;
+        header.generation = generation + 1;
+        header.checkpoint_seq = next_seq - 1;
+        header.image_bytes = image_bytes;
+        header.active_copy = target;
+        header.crc = crc32(&header, sizeof(header));
+        if (!writeAll(state_fd, &header, sizeof(header), static_cast<off_t>(header.generation % 2) * header_slot_bytes) ||
+            ::fdatasync(state_fd) != 0) {
+            return fail(error, "Cannot write state header");
+        }
+        generation = header.generation;
+        active_copy = target;
+        
+        if (::ftruncate(journal_fd, 0) != 0) {
+            return fail(error, "Cannot truncate " + journal_path);
+        }
+        journal_bytes = 0;
+        return true;
+    }
+
+private:
+    QueueStore() = default;
+};
+
+#endif
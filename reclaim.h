@@ -0,0 +1,351 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <new>
+#include <vector>
+
+/*
+ * Deferred reclamation for lock-free structures: an object unlinked by one
+ * thread may still be read by others, so it is retired instead of deleted
+ * and destroyed once no reader can hold it. Two schemes share the same
+ * per-thread shape (a Thread handle that registers with its domain, a
+ * retire(object) call and a pending() count of retired but not yet freed
+ * objects):
+ *
+ * EpochDomain makes readers announce the global epoch while inside a Guard.
+ * Entering and leaving cost one store each and any number of objects can be
+ * read, but a single reader stalled inside a Guard stops the epoch and every
+ * thread's garbage grows until it leaves.
+ *
+ * HazardDomain makes readers publish each pointer they are about to use in
+ * one of slots_per_thread hazard slots. Every protected load costs a store
+ * and a full fence, but a stalled reader only pins the objects in its slots,
+ * so garbage stays bounded. Use it for readers that hold objects for long.
+ *
+ * Objects must be unlinked with a seq_cst operation before they are retired:
+ * neither scheme issues a separate fence, and the single total order is what
+ * keeps a reader's announcement and a reclaimer's check from passing each
+ * other.
+ */
+
+struct RetiredObject {
+    void* object;
+    void (*destroy)(void*);
+    uint64_t epoch;
+};
+
+template <typename T>
+void destroyRetired(void* object) {
+    delete static_cast<T*>(object);
+}
+
+class EpochDomain {
+public:
+    static constexpr int max_threads = 64;
+    // Each thread tries to advance the epoch and frees what it can every
+    // collect_interval retirements.
+    static constexpr size_t collect_interval = 64;
+
+private:
+    struct alignas(64) Participant {
+        // 0 while outside a Guard, otherwise the epoch seen on entry.
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> in_use{false};
+        std::atomic<size_t> pending{0};
+        // Owned by the registered thread; kept across registrations so a
+        // departing thread's garbage is freed by the next one in the slot.
+        std::deque<RetiredObject> limbo;
+        size_t since_collect{0};
+        unsigned nesting{0};
+    };
+
+    alignas(64) std::atomic<uint64_t> global_epoch{1};
+    Participant participants[max_threads];
+
+    // Advances the epoch if every thread inside a Guard has seen the
+    // current one.
+    void tryAdvance() {
+        uint64_t current = global_epoch.load(std::memory_order_seq_cst);
+        for (const auto& participant : participants) {
+            if (!participant.in_use.load(std::memory_order_acquire)) {
+                continue;
+            }
+            uint64_t seen = participant.epoch.load(std::memory_order_seq_cst);
+            if (seen != 0 && seen != current) {
+                return;
+            }
+        }
+        global_epoch.compare_exchange_strong(current, current + 1, std::memory_order_seq_cst);
+    }
+
+    // Objects retired in epoch e may be held by threads that entered in e,
+    // which have all left once the epoch has moved two steps past it.
+    void collect(Participant& participant) {
+        tryAdvance();
+        uint64_t safe = global_epoch.load(std::memory_order_acquire);
+        size_t freed = 0;
+        while (!participant.limbo.empty() && participant.limbo.front().epoch + 2 <= safe) {
+            RetiredObject retired = participant.limbo.front();
+            participant.limbo.pop_front();
+            retired.destroy(retired.object);
+            freed++;
+        }
+        participant.pending.fetch_sub(freed, std::memory_order_relaxed);
+        participant.since_collect = 0;
+    }
+
+public:
+    EpochDomain() = default;
+
+    // Frees everything still retired; no thread may be registered.
+    ~EpochDomain() {
+        for (auto& participant : participants) {
+            for (const auto& retired : participant.limbo) {
+                retired.destroy(retired.object);
+            }
+        }
+    }
+
+    EpochDomain(const EpochDomain&) = delete;
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    uint64_t epoch() const {
+        return global_epoch.load(std::memory_order_relaxed);
+    }
+
+    size_t pending() const {
+        size_t total = 0;
+        for (const auto& participant : participants) {
+            total += participant.pending.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    class Thread {
+    private:
+        EpochDomain& domain;
+        Participant* participant{nullptr};
+
+    public:
+        // Throws std::bad_alloc when max_threads are already registered.
+        explicit Thread(EpochDomain& owner) : domain(owner) {
+            for (auto& candidate : domain.participants) {
+                bool expected = false;
+                if (candidate.in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    participant = &candidate;
+                    return;
+                }
+            }
+            throw std::bad_alloc();
+        }
+
+        ~Thread() {
+            domain.collect(*participant);
+            participant->epoch.store(0, std::memory_order_release);
+            participant->in_use.store(false, std::memory_order_release);
+        }
+
+        Thread(const Thread&) = delete;
+        Thread& operator=(const Thread&) = delete;
+
+        void enter() {
+            if (participant->nesting++ > 0) {
+                return;
+            }
+            // A full barrier, so the announcement is visible before any
+            // shared pointer is read.
+            participant->epoch.exchange(domain.global_epoch.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+        }
+
+        void exit() {
+            if (--participant->nesting == 0) {
+                participant->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        template <typename T>
+        void retire(T* object) {
+            retire(object, destroyRetired<T>);
+        }
+
+        void retire(void* object, void (*destroy)(void*)) {
+            participant->limbo.push_back({object, destroy, domain.global_epoch.load(std::memory_order_relaxed)});
+            participant->pending.fetch_add(1, std::memory_order_relaxed);
+            if (++participant->since_collect >= collect_interval) {
+                domain.collect(*participant);
+            }
+        }
+
+        size_t pending() const {
+            return participant->pending.load(std::memory_order_relaxed);
+        }
+    };
+
+    class Guard {
+    private:
+        Thread& thread;
+
+    public:
+        explicit Guard(Thread& owner) : thread(owner) {
+            thread.enter();
+        }
+
+        ~Guard() {
+            thread.exit();
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+};
+
+class HazardDomain {
+public:
+    static constexpr int max_threads = 64;
+    static constexpr int slots_per_thread = 4;
+
+private:
+    struct alignas(64) Record {
+        std::atomic<void*> hazards[slots_per_thread]{};
+        std::atomic<bool> in_use{false};
+        std::atomic<size_t> pending{0};
+        std::vector<RetiredObject> retired;
+    };
+
+    Record records[max_threads];
+
+    // Frees the record's retired objects that no hazard slot points to.
+    void scan(Record& record) {
+        std::vector<void*> protected_objects;
+        protected_objects.reserve(max_threads * slots_per_thread);
+        for (const auto& other : records) {
+            if (!other.in_use.load(std::memory_order_acquire)) {
+                continue;
+            }
+            for (const auto& hazard : other.hazards) {
+                void* object = hazard.load(std::memory_order_seq_cst);
+                if (object != nullptr) {
+                    protected_objects.push_back(object);
+                }
+            }
+        }
+        std::sort(protected_objects.begin(), protected_objects.end());
+
+        size_t kept = 0;
+        for (const auto& retired : record.retired) {
+            if (std::binary_search(protected_objects.begin(), protected_objects.end(), retired.object)) {
+                record.retired[kept++] = retired;
+            } else {
+                retired.destroy(retired.object);
+            }
+        }
+        record.retired.resize(kept);
+        record.pending.store(kept, std::memory_order_relaxed);
+    }
+
+public:
+    HazardDomain() = default;
+
+    // Frees everything still retired; no thread may be registered.
+    ~HazardDomain() {
+        for (auto& record : records) {
+            for (const auto& retired : record.retired) {
+                retired.destroy(retired.object);
+            }
+        }
+    }
+
+    HazardDomain(const HazardDomain&) = delete;
+    HazardDomain& operator=(const HazardDomain&) = delete;
+
+    size_t pending() const {
+        size_t total = 0;
+        for (const auto& record : records) {
+            total += record.pending.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // A thread scans once it has retired this many objects, so each thread
+    // holds at most scanThreshold() + max_threads * slots_per_thread.
+    static constexpr size_t scanThreshold() {
+        return 2 * max_threads * slots_per_thread;
+    }
+
+    class Thread {
+    private:
+        HazardDomain& domain;
+        Record* record{nullptr};
+
+    public:
+        // Throws std::bad_alloc when max_threads are already registered.
+        explicit Thread(HazardDomain& owner) : domain(owner) {
+            for (auto& candidate : domain.records) {
+                bool expected = false;
+                if (candidate.in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                    record = &candidate;
+                    return;
+                }
+            }
+            throw std::bad_alloc();
+        }
+
+        ~Thread() {
+            clearAll();
+            domain.scan(*record);
+            record->in_use.store(false, std::memory_order_release);
+        }
+
+        Thread(const Thread&) = delete;
+        Thread& operator=(const Thread&) = delete;
+
+        // Loads source into a hazard slot and returns it once the slot is
+        // published and source still holds the same pointer.
+        template <typename T>
+        T* protect(int slot, const std::atomic<T*>& source) {
+            T* object = source.load(std::memory_order_relaxed);
+            while (true) {
+                record->hazards[slot].store(object, std::memory_order_seq_cst);
+                T* current = source.load(std::memory_order_seq_cst);
+                if (current == object) {
+                    return object;
+                }
+                object = current;
+            }
+        }
+
+        void clear(int slot) {
+            record->hazards[slot].store(nullptr, std::memory_order_release);
+        }
+
+        void clearAll() {
+            for (int slot = 0; slot < slots_per_thread; slot++) {
+                clear(slot);
+            }
+        }
+
+        template <typename T>
+        void retire(T* object) {
+            retire(object, destroyRetired<T>);
+        }
+
+        void retire(void* object, void (*destroy)(void*)) {
+            record->retired.push_back({object, destroy, 0});
+            record->pending.fetch_add(1, std::memory_order_relaxed);
+            if (record->retired.size() >= scanThreshold()) {
+                domain.scan(*record);
+            }
+        }
+
+        size_t pending() const {
+            return record->pending.load(std::memory_order_relaxed);
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,284 @@
+#ifndef SCENARIO_SCHEDULE_H
+#define SCENARIO_SCHEDULE_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+ * Load scenarios (--scenario=FILE): time-varying arrival rates and role mixes
+ * plus bursts, capacity changes and outages, shared by the virtual-time
+ * engines and the real-time producer.
+ */
+
+struct ArrivalSegment {
+    double start;
+    double end;
+    double rate_start;
+    double rate_end;
+    double role_weights[3];
+    double cumulative_start;
+    double cumulative_end;
+};
+
+struct ScenarioEvent {
+    enum Kind { Burst, Capacity, Offline };
+    
+    double time;
+    Kind kind;
+    int value;
+};
+
+// A scenario compiled into piecewise-linear arrival rates and a sorted list of
+// discrete events. Arrivals form a non-homogeneous Poisson process that is
+// sampled by inverting the cumulative rate, so each arrival costs O(1).
+class ScenarioSchedule {
+private:
+    struct Directive {
+        double time;
+        std::string command;
+        std::vector<double> args;
+    };
+    
+    struct RatePiece {
+        double start;
+        double from_time;
+        double from_rate;
+        double to_time;
+        double to_rate;
+        
+        double rateAt(double t) const {
+            if (t >= to_time || to_time <= from_time) {
+                return to_rate;
+            }
+            return from_rate + (to_rate - from_rate) * (t - from_time) / (to_time - from_time);
+        }
+    };
+    
+    // Accepts plain seconds or unit suffixes, e.g. "90", "1.5m" or "2h30m".
+    static bool parseTime(const std::string& text, double& seconds) {
+        seconds = 0.0;
+        const char* cursor = text.c_str();
+        while (*cursor != '\0') {
+            char* end = nullptr;
+            double value = std::strtod(cursor, &end);
+            if (end == cursor || value < 0) {
+                return false;
+            }
+            double scale = 1.0;
+            switch (*end) {
+                case 'h': scale = 3600.0; end++; break;
+                case 'm': scale = 60.0; end++; break;
+                case 's': end++; break;
+                case '\0': break;
+                default: return false;
+            }
+            seconds += value * scale;
+            cursor = end;
+        }
+        return !text.empty();
+    }
+    
+    // Rates, weights and counts are plain non-negative numbers; a unit suffix
+    // is rejected rather than read as a time.
+    static bool parseNumber(const std::string& text, double& value) {
+        char* end = nullptr;
+        value = std::strtod(text.c_str(), &end);
+        return !text.empty() && *end == '\0' && std::isfinite(value) && value >= 0;
+    }
+
+    void compile(const std::vector<Directive>& directives) {
+        std::vector<RatePiece> pieces{{0.0, 0.0, 0.0, 0.0, 0.0}};
+        std::vector<std::pair<double, std::array<double, 3>>> mixes{{0.0, {1.0, 1.0, 1.0}}};
+        std::vector<double> boundaries{0.0, duration};
+        
+        for (const auto& directive : directives) {
+            double t = directive.time;
+            const auto& args = directive.args;
+            if (directive.command == "rate") {
+                pieces.push_back({t, t, args[0], t, args[0]});
+            } else if (directive.command == "ramp") {
+                pieces.push_back({t, t, pieces.back().rateAt(t), t + args[1], args[0]});
+                boundaries.push_back(t + args[1]);
+            } else if (directive.command == "mix") {
+                mixes.push_back({t, {args[0], args[1], args[2]}});
+            } else if (directive.command == "burst") {
+                events.push_back({t, ScenarioEvent::Burst, static_cast<int>(args[0])});
+            } else if (directive.command == "capacity") {
+                events.push_back({t, ScenarioEvent::Capacity, static_cast<int>(args[0])});
+            } else if (directive.command == "outage") {
+                events.push_back({t, ScenarioEvent::Offline, static_cast<int>(args[0])});
+                events.push_back({t + args[1], ScenarioEvent::Offline, -static_cast<int>(args[0])});
+            }
+            boundaries.push_back(t);
+        }
+        std::stable_sort(events.begin(), events.end(),
+                         [](const ScenarioEvent& a, const ScenarioEvent& b) { return a.time < b.time; });
+        
+        std::sort(boundaries.begin(), boundaries.end());
+        boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+        
+        auto pieceBefore = [&](double t, bool inclusive) -> const RatePiece& {
+            size_t chosen = 0;
+            for (size_t i = 0; i < pieces.size(); i++) {
+                if (inclusive ? pieces[i].start <= t : pieces[i].start < t) {
+                    chosen = i;
+                }
+            }
+            return pieces[chosen];
+        };
+        
+        double cumulative = 0.0;
+        for (size_t i = 0; i + 1 < boundaries.size() && boundaries[i] < duration; i++) {
+            ArrivalSegment segment;
+            segment.start = boundaries[i];
+            segment.end = std::min(boundaries[i + 1], duration);
+            segment.rate_start = std::max(0.0, pieceBefore(segment.start, true).rateAt(segment.start));
+            segment.rate_end = std::max(0.0, pieceBefore(segment.end, false).rateAt(segment.end));
+            const auto* mix = &mixes.front().second;
+            for (const auto& [time, weights] : mixes) {
+                if (time <= segment.start) {
+                    mix = &weights;
+                }
+            }
+            std::copy(mix->begin(), mix->end(), segment.role_weights);
+            segment.cumulative_start = cumulative;
+            cumulative += (segment.rate_start + segment.rate_end) / 2.0 * (segment.end - segment.start);
+            segment.cumulative_end = cumulative;
+            segments.push_back(segment);
+        }
+    }
+
+public:
+    double duration{0.0};
+    std::vector<ArrivalSegment> segments;
+    std::vector<ScenarioEvent> events;
+    
+    bool load(const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "Cannot open scenario " << path << std::endl;
+            return false;
+        }
+        
+        std::vector<Directive> directives;
+        std::string line;
+        int line_number = 0;
+        while (std::getline(in, line)) {
+            line_number++;
+            line = line.substr(0, line.find('#'));
+            std::istringstream words(line);
+            std::string keyword;
+            if (!(words >> keyword)) {
+                continue;
+            }
+            
+            auto fail = [&](const std::string& message) {
+                std::cerr << path << ":" << line_number << ": " << message << std::endl;
+                return false;
+            };
+            std::string word;
+            if (keyword == "duration") {
+                if (!(words >> word) || !parseTime(word, duration) || duration <= 0) {
+                    return fail("expected 'duration <time>'");
+                }
+                continue;
+            }
+            if (keyword != "at") {
+                return fail("unknown keyword '" + keyword + "'");
+            }
+            
+            Directive directive{0.0, "", {}};
+            if (!(words >> word) || !parseTime(word, directive.time) || !(words >> directive.command)) {
+                return fail("expected 'at <time> <command> ...'");
+            }
+            if (directive.command != "rate" && directive.command != "ramp" && directive.command != "mix" &&
+                directive.command != "burst" && directive.command != "capacity" && directive.command != "outage") {
+                return fail("unknown command '" + directive.command + "'");
+            }
+            size_t expected = directive.command == "mix" ? 3
+                            : directive.command == "ramp" || directive.command == "outage" ? 2
+                            : 1;
+            // Only the period of a ramp or an outage is a time.
+            bool period_last = directive.command == "ramp" || directive.command == "outage";
+            while (words >> word) {
+                double value;
+                bool is_time = period_last && directive.args.size() + 1 == expected;
+                if (is_time ? !parseTime(word, value) : !parseNumber(word, value)) {
+                    return fail(std::string(is_time ? "invalid time '" : "invalid number '") + word + "'");
+                }
+                directive.args.push_back(value);
+            }
+            
+            if (directive.args.size() != expected) {
+                return fail("'" + directive.command + "' takes " + std::to_string(expected) + " argument(s)");
+            }
+            bool counts_instances = directive.command == "burst" || directive.command == "capacity" ||
+                                    directive.command == "outage";
+            if (counts_instances && directive.args[0] > std::numeric_limits<int>::max()) {
+                return fail("'" + directive.command + "' count is too large");
+            }
+            if (directive.command == "mix" && directive.args[0] + directive.args[1] + directive.args[2] <= 0) {
+                return fail("role mix must have a positive weight");
+            }
+            directives.push_back(directive);
+        }
+        
+        if (duration <= 0) {
+            std::cerr << path << ": missing 'duration'" << std::endl;
+            return false;
+        }
+        std::stable_sort(directives.begin(), directives.end(),
+                         [](const Directive& a, const Directive& b) { return a.time < b.time; });
+        compile(directives);
+        return true;
+    }
+    
+    double expectedArrivals() const {
+        return segments.empty() ? 0.0 : segments.back().cumulative_end;
+    }
+    
+    // Advances cumulative by one unit-rate exponential step and returns the
+    // arrival time, or a time past duration when the scenario has no more
+    // arrivals. segment is a cursor that only moves forward.
+    double nextArrival(double& cumulative, size_t& segment, double exponential_step) const {
+        cumulative += exponential_step;
+        while (segment < segments.size() && cumulative > segments[segment].cumulative_end) {
+            segment++;
+        }
+        if (segment >= segments.size()) {
+            return duration + 1.0;
+        }
+        
+        const ArrivalSegment& s = segments[segment];
+        double delta = cumulative - s.cumulative_start;
+        double slope = (s.rate_end - s.rate_start) / (s.end - s.start);
+        double root = std::sqrt(std::max(0.0, s.rate_start * s.rate_start + 2.0 * slope * delta));
+        double offset = s.rate_start + root > 0 ? 2.0 * delta / (s.rate_start + root) : 0.0;
+        return std::min(s.end, s.start + offset);
+    }
+    
+    int pickRole(size_t segment, double uniform) const {
+        const double* weights = segments[std::min(segment, segments.size() - 1)].role_weights;
+        double target = uniform * (weights[0] + weights[1] + weights[2]);
+        return target < weights[0] ? 0 : target < weights[0] + weights[1] ? 1 : 2;
+    }
+    
+    int roleAt(double time, double uniform) const {
+        size_t segment = 0;
+        while (segment + 1 < segments.size() && segments[segment + 1].start <= time) {
+            segment++;
+        }
+        return pickRole(segment, uniform);
+    }
+};
+
+#endif
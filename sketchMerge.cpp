@@ -0,0 +1,120 @@
+#include "ddSketch.h"
+#include "eventOutput.h"
+#include "toolOptions.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+// Combines sketch files written with --sketch-out by separate runs, shards or
+// nodes. Sketches with the same name are merged; with --rollup the "/shardN"
+// or "/role" qualifier is dropped first so everything rolls up into one
+// global sketch per metric.
+
+bool readFile(const std::string& path, std::string& contents) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> paths;
+    std::string out_path;
+    bool rollup = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--rollup") {
+            rollup = true;
+        } else if (parseOption(arg, "--out", out_path)) {
+            continue;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        } else {
+            paths.push_back(arg);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "Usage: " << argv[0] << " FILE... [--rollup] [--out=PATH]" << std::endl;
+        return 1;
+    }
+
+    std::vector<NamedSketches> inputs(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        std::string contents;
+        if (!readFile(paths[i], contents)) {
+            std::cerr << "Cannot open " << paths[i] << std::endl;
+            return 1;
+        }
+        if (!parseSketches(contents, inputs[i])) {
+            std::cerr << paths[i] << " is not a sketch file or is truncated." << std::endl;
+            return 1;
+        }
+    }
+    auto keyOf = [rollup](const std::string& name) {
+        return rollup ? name.substr(0, name.find('/')) : name;
+    };
+
+    // Each merged sketch keeps the largest bucket limit among its inputs, so
+    // merging never folds buckets that an input kept apart.
+    NamedSketches merged;
+    for (const auto& sketches : inputs) {
+        for (const auto& [name, sketch] : sketches) {
+            std::string key = keyOf(name);
+            auto it = std::find_if(merged.begin(), merged.end(), [&key](const auto& entry) {
+                return entry.first == key;
+            });
+            if (it == merged.end()) {
+                merged.emplace_back(key, DDSketch(sketch.relativeAccuracy(), sketch.bucketLimit()));
+            } else if (sketch.bucketLimit() > it->second.bucketLimit()) {
+                it->second = DDSketch(it->second.relativeAccuracy(), sketch.bucketLimit());
+            }
+        }
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        const std::string& path = paths[i];
+        for (const auto& [name, sketch] : inputs[i]) {
+            std::string key = keyOf(name);
+            auto it = std::find_if(merged.begin(), merged.end(), [&key](const auto& entry) {
+                return entry.first == key;
+            });
+            if (!it->second.merge(sketch)) {
+                std::cerr << path << ": " << name << " was built with a different relative accuracy ("
+                          << sketch.relativeAccuracy() << " vs " << it->second.relativeAccuracy() << ")." << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    std::cout << "Merged " << paths.size() << " file(s) into " << merged.size() << " sketch(es)" << std::endl;
+    std::cout << std::left << std::setw(20) << "Sketch" << std::right << std::setw(12) << "Count"
+              << std::setw(10) << "Mean" << std::setw(10) << "p50" << std::setw(10) << "p90"
+              << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "Max" << std::endl;
+    std::cout << std::string(92, '-') << std::endl;
+    for (const auto& [name, sketch] : merged) {
+        std::cout << std::left << std::setw(20) << name << std::right << std::setw(12) << sketch.count()
+                  << std::fixed << std::setprecision(2) << std::setw(10) << sketch.mean()
+                  << std::setw(10) << sketch.quantile(0.5) << std::setw(10) << sketch.quantile(0.9)
+                  << std::setw(10) << sketch.quantile(0.99) << std::setw(10) << sketch.quantile(0.999)
+                  << std::setw(10) << sketch.quantile(1.0) << std::endl;
+    }
+
+    if (!out_path.empty()) {
+        if (!writeFileAtomically(out_path, serializeSketches(merged))) {
+            std::cerr << "Failed to write " << out_path << std::endl;
+            return 1;
+        }
+        std::cout << "Merged sketches written to " << out_path << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,247 @@
+#include "queueManager.h"
+#include "toolOptions.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <climits>
+
+// Randomized concurrency harness for the real-time DungeonManager. Build it
+// with -fsanitize=thread as well to catch data races.
+
+struct StressTotals {
+    long long rounds{0};
+    long long parties{0};
+    long long players_enqueued{0};
+    long long players_cancelled{0};
+    long long players_expired{0};
+    long long checks{0};
+    long long violations{0};
+    std::string first_violation;
+};
+
+// Runs randomized rounds against fresh managers: producers, cancellers and an
+// expirer hammer the queues while a checker verifies the invariants, and each
+// round ends with the workers and clients stopped in a random order. After a
+// round the players the clients added and removed are compared with the
+// manager's counters, which catches lost or doubled updates that leave the
+// manager consistent with itself.
+int runStressTest(int seconds, int threads, uint64_t seed) {
+    std::mt19937_64 round_gen(seed);
+    StressTotals totals;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(seconds);
+    auto next_report = start + std::chrono::seconds(5);
+    long long parties_at_report = 0;
+
+    std::cout << "=== STRESS TEST ===" << std::endl;
+    std::cout << "Duration: " << seconds << "s | Client threads per round: up to " << threads
+              << " | Seed: " << seed << std::endl;
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        int instances = std::uniform_int_distribution<>(1, 64)(round_gen);
+        int producers = std::uniform_int_distribution<>(1, std::max(1, threads - 1))(round_gen);
+        int cancellers = std::uniform_int_distribution<>(0, std::max(0, threads - producers))(round_gen);
+        bool expire = round_gen() % 2 == 0;
+        auto timeout = std::chrono::microseconds(std::uniform_int_distribution<>(100, 20000)(round_gen));
+        auto round_length = std::chrono::milliseconds(std::uniform_int_distribution<>(20, 300)(round_gen));
+        bool workers_first = round_gen() % 2 == 0;
+
+        int initial_tanks = std::uniform_int_distribution<>(0, 10)(round_gen);
+        DungeonManager manager(instances, initial_tanks, 0, 0);
+        manager.setVerbose(false);
+        manager.startWorkers(0, 0);
+
+        std::atomic<bool> stop_clients{false};
+        std::atomic<bool> stop_checker{false};
+        std::atomic<long long> enqueued[3]{};
+        std::atomic<long long> cancelled[3]{};
+        std::atomic<long long> expired{0};
+        std::atomic<long long> checks{0};
+        std::mutex violation_mtx;
+        long long violations = 0;
+        std::string first_violation;
+        auto record = [&](const std::string& violation) {
+            std::lock_guard<std::mutex> lock(violation_mtx);
+            if (violations++ == 0) {
+                first_violation = violation;
+            }
+        };
+
+        std::vector<std::thread> clients;
+        for (int p = 0; p < producers; p++) {
+            uint64_t client_seed = round_gen();
+            clients.emplace_back([&, client_seed]() {
+                std::mt19937_64 gen(client_seed);
+                std::uniform_int_distribution<> count_dist(0, 2);
+                while (!stop_clients.load(std::memory_order_relaxed)) {
+                    int t = count_dist(gen);
+                    int h = count_dist(gen);
+                    int d = count_dist(gen) + count_dist(gen) + count_dist(gen);
+                    if (manager.enqueuePlayers(t, h, d)) {
+                        enqueued[0].fetch_add(t, std::memory_order_relaxed);
+                        enqueued[1].fetch_add(h, std::memory_order_relaxed);
+                        enqueued[2].fetch_add(d, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+        for (int c = 0; c < cancellers; c++) {
+            uint64_t client_seed = round_gen();
+            clients.emplace_back([&, client_seed]() {
+                std::mt19937_64 gen(client_seed);
+                while (!stop_clients.load(std::memory_order_relaxed)) {
+                    int role = static_cast<int>(gen() % 3);
+                    cancelled[role].fetch_add(manager.cancelPlayers(role, 1 + gen() % 3), std::memory_order_relaxed);
+                    std::this_thread::yield();
+                }
+            });
+        }
+        if (expire) {
+            clients.emplace_back([&]() {
+                while (!stop_clients.load(std::memory_order_relaxed)) {
+                    expired.fetch_add(manager.expirePlayers(timeout), std::memory_order_relaxed);
+                    std::this_thread::sleep_for(timeout / 4);
+                }
+            });
+        }
+        std::thread checker([&]() {
+            std::string violation;
+            while (!stop_checker.load(std::memory_order_relaxed)) {
+                if (!manager.checkInvariants(violation)) {
+                    record(violation);
+                }
+                checks.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+
+        std::this_thread::sleep_for(round_length);
+        auto stopClients = [&]() {
+            stop_clients = true;
+            for (auto& client : clients) {
+                client.join();
+            }
+        };
+        if (workers_first) {
+            manager.stopWorkers();
+            stopClients();
+        } else {
+            stopClients();
+            manager.stopWorkers();
+        }
+        stop_checker = true;
+        checker.join();
+
+        std::string violation;
+        if (!manager.checkInvariants(violation)) {
+            record("after shutdown: " + violation);
+        }
+
+        static const char* role_names[]{"tanks", "healers", "dps"};
+        DungeonManager::PlayerTotals counted = manager.playerTotals();
+        std::ostringstream mismatch;
+        long long counted_expired = 0;
+        for (int role = 0; role < 3; role++) {
+            long long sent = enqueued[role] + (role == 0 ? initial_tanks : 0);
+            if (counted.added[role] != sent) {
+                mismatch << role_names[role] << ": manager added " << counted.added[role] << " != clients sent "
+                         << sent << "; ";
+            }
+            if (counted.cancelled[role] != cancelled[role]) {
+                mismatch << role_names[role] << ": manager cancelled " << counted.cancelled[role]
+                         << " != clients cancelled " << cancelled[role] << "; ";
+            }
+            counted_expired += counted.expired[role];
+        }
+        if (counted_expired != expired) {
+            mismatch << "manager expired " << counted_expired << " != expirer removed " << expired << "; ";
+        }
+        if (!mismatch.str().empty()) {
+            record("client totals: " + mismatch.str());
+        }
+
+        totals.rounds++;
+        totals.parties += manager.partiesFormed();
+        for (int role = 0; role < 3; role++) {
+            totals.players_enqueued += enqueued[role];
+            totals.players_cancelled += cancelled[role];
+        }
+        totals.players_expired += expired;
+        totals.checks += checks + 1;
+        totals.violations += violations;
+        if (totals.first_violation.empty() && !first_violation.empty()) {
+            totals.first_violation = "round " + std::to_string(totals.rounds) + ": " + first_violation;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_report) {
+            double elapsed = std::chrono::duration<double>(now - start).count();
+            std::cout << std::fixed << std::setprecision(0) << elapsed << "s: " << totals.rounds << " rounds, "
+                      << (totals.parties - parties_at_report) / 5.0 << " parties/s over the last 5s, "
+                      << totals.violations << " violation(s)" << std::endl;
+            parties_at_report = totals.parties;
+            next_report += std::chrono::seconds(5);
+        }
+    }
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::string(60, '-') << std::endl;
+    std::cout << "Rounds: " << totals.rounds << " | Invariant checks: " << totals.checks << std::endl;
+    std::cout << "Players enqueued: " << totals.players_enqueued << " | Cancelled: " << totals.players_cancelled
+              << " | Expired: " << totals.players_expired << std::endl;
+    std::cout << "Sustained throughput: " << std::fixed << std::setprecision(0) << totals.parties / elapsed
+              << " parties/s, " << totals.players_enqueued / elapsed << " players enqueued/s" << std::endl;
+    if (totals.violations > 0) {
+        std::cout << "INVARIANT VIOLATIONS: " << totals.violations << std::endl;
+        std::cout << "First: " << totals.first_violation << std::endl;
+        return 1;
+    }
+    std::cout << "No invariant violations." << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    int seconds = 60;
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value;
+        long long count = 0;
+        if (parseOption(arg, "--seconds", value)) {
+            if (!parseCount(value, 1, INT_MAX, count)) {
+                std::cerr << "--seconds must be a positive integer." << std::endl;
+                return 1;
+            }
+            seconds = static_cast<int>(count);
+        } else if (parseOption(arg, "--threads", value)) {
+            if (!parseCount(value, 1, INT_MAX, count)) {
+                std::cerr << "--threads must be a positive integer." << std::endl;
+                return 1;
+            }
+            threads = static_cast<int>(count);
+        } else if (parseOption(arg, "--seed", value)) {
+            char* end = nullptr;
+            seed = std::strtoull(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0') {
+                std::cerr << "--seed must be a non-negative integer." << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--seconds=N] [--threads=N] [--seed=N]" << std::endl;
+            return 1;
+        }
+    }
+    return runStressTest(seconds, threads, seed);
+}
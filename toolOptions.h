@@ -0,0 +1,35 @@
+#ifndef TOOL_OPTIONS_H
+#define TOOL_OPTIONS_H
+
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+
+/*
+ * Command-line helpers shared by the standalone tools (eventQuery,
+ * sketchMerge, stressTest and the bench* drivers). Options are written
+ * --name=value; numbers must be whole decimal integers inside the stated
+ * range, so typos fail loudly instead of reading as 0.
+ */
+
+inline bool parseOption(const std::string& arg, const std::string& name, std::string& value) {
+    std::string prefix = name + "=";
+    if (arg.rfind(prefix, 0) != 0) {
+        return false;
+    }
+    value = arg.substr(prefix.size());
+    return true;
+}
+
+inline bool parseCount(const std::string& text, long long min_value, long long max_value, long long& value) {
+    char* end = nullptr;
+    errno = 0;
+    long long parsed = std::strtoll(text.c_str(), &end, 10);
+    if (text.empty() || *end != '\0' || errno != 0 || parsed < min_value || parsed > max_value) {
+        return false;
+    }
+    value = parsed;
+    return true;
+}
+
+#endif